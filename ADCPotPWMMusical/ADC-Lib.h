@@ -0,0 +1,375 @@
+#ifndef ADC_LIB_H
+#define ADC_LIB_H
+
+#include <GenericTypeDefs.h>
+#include "DSP-Filter.h"
+#include "Snap-Lib.h"
+
+/* Interrupt-driven multi-channel ADC scan engine
+ *
+ * A list of channels (AN0 - AN12) is converted in turn. Every ADIF interrupt
+ * stores the finished result, selects the next channel in the list and
+ * restarts the conversion. The acquisition time (ADCON2 ACQT) is inserted by
+ * the hardware after GO is set, so the new channel is always given the full
+ * acquisition time before it is sampled.
+ *
+ * Oversampling and decimation:
+ *   4^k samples of each channel are summed, then shifted right by k
+ *   -> 10 + k bits of result
+ *   ADC_OVERSAMPLE_1X  -> 10 bits
+ *   ADC_OVERSAMPLE_4X  -> 11 bits
+ *   ADC_OVERSAMPLE_16X -> 12 bits
+ *   ADC_OVERSAMPLE_64X -> 13 bits (64 * 1023 still fits in 16 bits)
+ * The extra bits are only real when there is some noise on the input.
+ *
+ * Each decimated result is pushed into a small per-channel ring buffer. The
+ * reader only takes the entry behind the write index, which the ISR does not
+ * touch again until the ring wraps, so reading never blocks. The latest
+ * result is kept in a Snap16 too (Snap-Lib.h): ADC_read() always gets both
+ * bytes of the same result, and ADC_readNew() tells main whether it has
+ * seen it already, with no interrupt held off for either.
+ *
+ * A DSP filter (DSP-Filter.h) can be attached to each channel with
+ * ADC_attachFilter(). It runs in the ISR on every decimated result, before it
+ * is pushed into the ring, so every reader sees the filtered value. The
+ * filter is seeded in the ISR with the first decimated result after it is
+ * attached, so its output does not ramp up from 0, even when it is attached
+ * before the first conversion.
+ *
+ * ADC clock and acquisition time are picked at compile time from FOSC and
+ * the source impedance ADC_SOURCE_OHMS (see below). The build fails when no
+ * legal setting exists for the clock.
+ *
+ * Hardware-timed sampling (ADC_startTriggered):
+ *   CCP2 in compare mode with special event trigger (CCP2M = 1011) resets
+ *   Timer3 and sets GO on every match, so each conversion starts at an exact
+ *   interval with no dependency on interrupt latency. The ISR then only stores
+ *   the result and selects the next channel, which gets the whole sample
+ *   period to settle. CCP2 can not be used for PWM in this mode.
+ *
+ * FOSC (in Hz, as an integer) must be defined before including this file:
+ *   #define FOSC (10000000UL) // 10MHz HS mode
+ */
+
+#ifndef FOSC
+#error "FOSC must be defined before including ADC-Lib.h"
+#endif
+
+#ifndef ADC_MAX_CHANNELS
+#define ADC_MAX_CHANNELS (4)
+#endif
+#ifndef ADC_RING_SIZE
+#define ADC_RING_SIZE (8) // Must be a power of 2
+#endif
+#define ADC_RING_MASK (ADC_RING_SIZE - 1)
+
+/* A/D timing limits (PIC18F4520 datasheet, parameters 130 and 19.1)
+ *   TAD must be 0.7us - 25us (1.4us for the PIC18LF part)
+ *   TACQ = TAMP + TC + TCOFF
+ *     TAMP  = 0.2us
+ *     TC    = CHOLD * (RIC + RSS + RS) * ln(2048)
+ *           = 25pF * (1k + 2k + RS) * 7.625
+ *           = (3000 + RS) * 61 / 320 ns
+ *     TCOFF = (Temp - 25C) * 0.02us/C
+ *   e.g. RS = 2.5k, 85C -> TACQ = 0.2 + 1.05 + 1.2 = 2.45us
+ */
+#ifndef ADC_TAD_MIN_NS
+#define ADC_TAD_MIN_NS (700)
+#endif
+#ifndef ADC_TAD_MAX_NS
+#define ADC_TAD_MAX_NS (25000)
+#endif
+#ifndef ADC_SOURCE_OHMS
+#define ADC_SOURCE_OHMS (2500) // Max recommended source impedance
+#endif
+#ifndef ADC_TEMP_MAX
+#define ADC_TEMP_MAX (85) // Celsius
+#endif
+
+#define ADC_FOSC_KHZ (FOSC / 1000)
+#define ADC_TACQ_NS (200 + (3000 + ADC_SOURCE_OHMS) * 61 / 320 + 1 + (ADC_TEMP_MAX - 25) * 20)
+
+/* ADCON2 ADCS: fastest FOSC divider with TAD >= ADC_TAD_MIN_NS
+ *   TAD = divider / FOSC -> divider * 1e6 / FOSC(kHz) ns
+ */
+#ifndef ADC_ADCS
+#if (2 * 1000000 >= ADC_TAD_MIN_NS * ADC_FOSC_KHZ)
+#define ADC_ADCS (0b000) // FOSC/2
+#define ADC_TAD_DIV (2)
+#elif (4 * 1000000 >= ADC_TAD_MIN_NS * ADC_FOSC_KHZ)
+#define ADC_ADCS (0b100) // FOSC/4
+#define ADC_TAD_DIV (4)
+#elif (8 * 1000000 >= ADC_TAD_MIN_NS * ADC_FOSC_KHZ)
+#define ADC_ADCS (0b001) // FOSC/8
+#define ADC_TAD_DIV (8)
+#elif (16 * 1000000 >= ADC_TAD_MIN_NS * ADC_FOSC_KHZ)
+#define ADC_ADCS (0b101) // FOSC/16
+#define ADC_TAD_DIV (16)
+#elif (32 * 1000000 >= ADC_TAD_MIN_NS * ADC_FOSC_KHZ)
+#define ADC_ADCS (0b010) // FOSC/32
+#define ADC_TAD_DIV (32)
+#elif (64 * 1000000 >= ADC_TAD_MIN_NS * ADC_FOSC_KHZ)
+#define ADC_ADCS (0b110) // FOSC/64
+#define ADC_TAD_DIV (64)
+#else
+#error "FOSC too high: no ADCS divider gives a legal TAD"
+#endif
+#if (ADC_TAD_DIV * 1000000 / ADC_FOSC_KHZ > ADC_TAD_MAX_NS)
+#error "FOSC too low: TAD is above its maximum, define ADC_ADCS (0b011 = FRC) and ADC_TAD_DIV by hand"
+#endif
+#endif
+#ifndef ADC_TAD_DIV
+#error "ADC_TAD_DIV (TAD in TOSC) must be defined along with ADC_ADCS"
+#endif
+
+#define ADC_TAD_NS (ADC_TAD_DIV * 1000000 / ADC_FOSC_KHZ)
+
+/* ADCON2 ACQT: fewest TADs that cover TACQ */
+#ifndef ADC_ACQT
+#if (2 * ADC_TAD_NS >= ADC_TACQ_NS)
+#define ADC_ACQT (0b001) // 2 TAD
+#define ADC_ACQT_TAD (2)
+#elif (4 * ADC_TAD_NS >= ADC_TACQ_NS)
+#define ADC_ACQT (0b010) // 4 TAD
+#define ADC_ACQT_TAD (4)
+#elif (6 * ADC_TAD_NS >= ADC_TACQ_NS)
+#define ADC_ACQT (0b011) // 6 TAD
+#define ADC_ACQT_TAD (6)
+#elif (8 * ADC_TAD_NS >= ADC_TACQ_NS)
+#define ADC_ACQT (0b100) // 8 TAD
+#define ADC_ACQT_TAD (8)
+#elif (12 * ADC_TAD_NS >= ADC_TACQ_NS)
+#define ADC_ACQT (0b101) // 12 TAD
+#define ADC_ACQT_TAD (12)
+#elif (16 * ADC_TAD_NS >= ADC_TACQ_NS)
+#define ADC_ACQT (0b110) // 16 TAD
+#define ADC_ACQT_TAD (16)
+#elif (20 * ADC_TAD_NS >= ADC_TACQ_NS)
+#define ADC_ACQT (0b111) // 20 TAD
+#define ADC_ACQT_TAD (20)
+#else
+#error "Source impedance too high: 20 TAD is shorter than TACQ"
+#endif
+#endif
+#ifndef ADC_ACQT_TAD
+#define ADC_ACQT_TAD (20) // ACQT given by hand, assume the longest
+#endif
+
+#define ADC_OVERSAMPLE_1X  (0)
+#define ADC_OVERSAMPLE_4X  (1)
+#define ADC_OVERSAMPLE_16X (2)
+#define ADC_OVERSAMPLE_64X (3)
+
+/* Shortest trigger period: acquisition + 11 TAD conversion + 1 TAD
+ * discharge, plus 50 Tcy for the ISR
+ */
+#ifndef ADC_MIN_PERIOD_TCY
+#define ADC_MIN_PERIOD_TCY ((ADC_ACQT_TAD + 12) * ADC_TAD_DIV / 4 + 50)
+#endif
+
+UINT8 adc_channels[ADC_MAX_CHANNELS];
+UINT8 adc_count = 0;
+UINT8 adc_index = 0;
+UINT8 adc_shift = 0; // k, decimation shift
+UINT8 adc_samples = 1; // 4^k
+UINT16 adc_acc[ADC_MAX_CHANNELS];
+UINT8 adc_acc_count[ADC_MAX_CHANNELS];
+UINT16 adc_ring[ADC_MAX_CHANNELS][ADC_RING_SIZE];
+volatile UINT8 adc_head[ADC_MAX_CHANNELS];
+Snap16 adc_latest[ADC_MAX_CHANNELS];
+DSP_Filter adc_filter[ADC_MAX_CHANNELS];
+BOOL adc_seed[ADC_MAX_CHANNELS]; // Filter waits for its first sample
+BOOL adc_triggered = FALSE;
+
+// Function prototype
+void ADC_setupScan(const UINT8 *channels, UINT8 count, UINT8 oversample);
+void ADC_setPinAnalog(UINT8 channel);
+void ADC_start(void);
+BOOL ADC_startTriggered(UINT32 rate);
+void ADC_isr(void);
+void ADC_attachFilter(UINT8 index, UINT8 type);
+UINT16 ADC_read(UINT8 index);
+BOOL ADC_readNew(UINT8 index, UINT16 *value, UINT8 *seen);
+UINT16 ADC_readHistory(UINT8 index, UINT8 age);
+UINT16 ADC_getFullScale(void);
+
+
+void ADC_setPinAnalog(UINT8 channel) {
+    /* Set the pin of an analog channel as input */
+    switch (channel) {
+        case 0: TRISAbits.TRISA0 = 1; break;
+        case 1: TRISAbits.TRISA1 = 1; break;
+        case 2: TRISAbits.TRISA2 = 1; break;
+        case 3: TRISAbits.TRISA3 = 1; break;
+        case 4: TRISAbits.TRISA5 = 1; break;
+        case 5: TRISEbits.TRISE0 = 1; break;
+        case 6: TRISEbits.TRISE1 = 1; break;
+        case 7: TRISEbits.TRISE2 = 1; break;
+        case 8: TRISBbits.TRISB2 = 1; break;
+        case 9: TRISBbits.TRISB3 = 1; break;
+        case 10: TRISBbits.TRISB1 = 1; break;
+        case 11: TRISBbits.TRISB4 = 1; break;
+        case 12: TRISBbits.TRISB0 = 1; break;
+    }
+}
+
+void ADC_setupScan(const UINT8 *channels, UINT8 count, UINT8 oversample) {
+    UINT8 i, highest = 0;
+
+    if (count > ADC_MAX_CHANNELS) {
+        count = ADC_MAX_CHANNELS;
+    }
+    for (i = 0; i < count; i++) {
+        adc_channels[i] = channels[i];
+        adc_acc[i] = 0;
+        adc_acc_count[i] = 0;
+        adc_head[i] = 0;
+        adc_latest[i].seq = 0;
+        adc_latest[i].value = 0;
+        DSP_init(&adc_filter[i], DSP_NONE, 0);
+        adc_seed[i] = FALSE;
+        if (channels[i] > highest) {
+            highest = channels[i];
+        }
+        ADC_setPinAnalog(channels[i]);
+    }
+    adc_count = count;
+    adc_index = 0;
+    adc_shift = oversample;
+    adc_samples = 1 << (oversample * 2);
+
+    /* PCFG: 1110 = AN0 only, 1101 = AN0-AN1 ... 0010 = AN0-AN12
+     *   PCFG = 0b1110 - highest channel
+     */
+    ADCON1bits.PCFG = 0b1110 - highest;
+    ADCON1bits.VCFG1 = 0; // Vss as Vref-
+    ADCON1bits.VCFG0 = 0; // Vdd as Vref+
+
+    ADCON2bits.ADFM = 1; // Right Justified
+    ADCON2bits.ACQT = ADC_ACQT;
+    ADCON2bits.ADCS = ADC_ADCS;
+
+    ADCON0bits.CHS = adc_channels[0];
+    ADCON0bits.ADON = 1; // 1 = A/D Converter module is enabled
+}
+
+void ADC_start(void) {
+    PIR1bits.ADIF = 0; // Clear ADIF bit
+    PIE1bits.ADIE = 1; // Set ADIE bit
+    INTCONbits.PEIE = 1; // Set peripheral bit
+    ADCON0bits.GO = 1; // Start first conversion
+}
+
+BOOL ADC_startTriggered(UINT32 rate) {
+    /* Calculation for the trigger period
+     *   Timer3 counts Tcy / prescale, CCP2 match resets it and starts A/D
+     *   Period = (CCPR2 + 1) * 4 * TOSC * (TMR3 Prescale Value)
+     *   CCPR2 = FOSC / 4 / rate / prescale - 1
+     * Total sample rate = rate, per channel = rate / number of channels
+     */
+    UINT32 ticks;
+    UINT8 prescale_bits = 0b00; // 00 = 1:1 Prescale value
+
+    if (rate == 0) {
+        return FALSE;
+    }
+    ticks = (FOSC / 4 + rate / 2) / rate;
+    if (ticks < ADC_MIN_PERIOD_TCY) {
+        return FALSE; // Faster than the ADC can convert
+    }
+    while (ticks > 65536 && prescale_bits < 0b11) {
+        ticks = (ticks + 1) >> 1;
+        prescale_bits++; // 01 = 1:2, 10 = 1:4, 11 = 1:8
+    }
+    if (ticks > 65536) {
+        return FALSE;
+    }
+
+    adc_triggered = TRUE;
+
+    // Timer3 as the CCP2 time base, Timer1 stays with CCP1
+    T3CONbits.TMR3ON = 0;
+    T3CONbits.T3CCP2 = 0;
+    T3CONbits.T3CCP1 = 1; // 01 = Timer3 for CCP2, Timer1 for CCP1
+    T3CONbits.RD16 = 1; // 16-bit read/write
+    T3CONbits.TMR3CS = 0; // Internal clock (FOSC/4)
+    T3CONbits.T3CKPS = prescale_bits;
+    TMR3H = 0;
+    TMR3L = 0;
+
+    CCPR2H = (ticks - 1) >> 8;
+    CCPR2L = (ticks - 1) & 0xFF;
+    CCP2CONbits.CCP2M = 0b1011; // 1011 = Compare mode, trigger special event
+
+    PIR1bits.ADIF = 0; // Clear ADIF bit
+    PIE1bits.ADIE = 1; // Set ADIE bit
+    INTCONbits.PEIE = 1; // Set peripheral bit
+    T3CONbits.TMR3ON = 1; // First conversion starts at the first match
+    return TRUE;
+}
+
+void ADC_isr(void) {
+    /* Call from the ISR when PIR1bits.ADIF is set */
+    UINT8 i = adc_index;
+
+    PIR1bits.ADIF = 0; // Clear ADIF bit
+    adc_acc[i] += ((UINT16) ADRESH << 8) | ADRESL;
+
+    if (++adc_acc_count[i] >= adc_samples) {
+        UINT8 head = adc_head[i];
+        UINT16 value = adc_acc[i] >> adc_shift; // Decimate
+        if (adc_seed[i]) {
+            DSP_init(&adc_filter[i], adc_filter[i].type, value); // Once, after ADC_attachFilter()
+            adc_seed[i] = FALSE;
+        }
+        value = DSP_update(&adc_filter[i], value);
+        adc_ring[i][head] = value;
+        adc_head[i] = (head + 1) & ADC_RING_MASK;
+        Snap16_write(&adc_latest[i], value);
+        adc_acc[i] = 0;
+        adc_acc_count[i] = 0;
+    }
+
+    // Next channel in the list, hardware waits ACQT before converting
+    if (++i >= adc_count) {
+        i = 0;
+    }
+    adc_index = i;
+    ADCON0bits.CHS = adc_channels[i];
+    if (!adc_triggered) {
+        ADCON0bits.GO = 1; // Otherwise the next CCP2 match starts it
+    }
+}
+
+void ADC_attachFilter(UINT8 index, UINT8 type) {
+    /* Seeded by the ISR with the next decimated result, so the output does
+     * not ramp from 0 (nothing may have been converted yet)
+     */
+    BOOL adie = PIE1bits.ADIE;
+    PIE1bits.ADIE = 0; // Keep the ISR out while the filter is changed
+    DSP_init(&adc_filter[index], type, 0);
+    adc_seed[index] = TRUE;
+    PIE1bits.ADIE = adie;
+}
+
+UINT16 ADC_read(UINT8 index) {
+    /* Latest decimated value of the index-th channel in the scan list */
+    return Snap16_read(&adc_latest[index]);
+}
+
+BOOL ADC_readNew(UINT8 index, UINT16 *value, UINT8 *seen) {
+    /* Latest value, TRUE if it came since the last call with this seen */
+    return Snap16_readNew(&adc_latest[index], value, seen);
+}
+
+UINT16 ADC_readHistory(UINT8 index, UINT8 age) {
+    /* age 0 = latest, up to ADC_RING_SIZE - 2 */
+    UINT8 slot = (adc_head[index] - 1 - age) & ADC_RING_MASK;
+    return adc_ring[index][slot];
+}
+
+UINT16 ADC_getFullScale(void) {
+    return 1024 << adc_shift;
+}
+
+#endif
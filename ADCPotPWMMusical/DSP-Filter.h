@@ -0,0 +1,186 @@
+#ifndef DSP_FILTER_H
+#define DSP_FILTER_H
+
+#include <GenericTypeDefs.h>
+
+/* Small fixed-point filters, cheap enough to run inside an ISR
+ *
+ * DSP_MOVING_AVERAGE
+ *   Mean of the last 2^DSP_MA_SHIFT samples. A running sum is kept, so every
+ *   update is one subtract, one add and one shift whatever the window size.
+ *   Limit: 2^DSP_MA_SHIFT * largest input < 65536 (e.g. 8 x 13-bit, 16 x 12-bit)
+ *
+ * DSP_IIR
+ *   Single-pole low-pass: y += (x - y) / 2^DSP_IIR_SHIFT
+ *   y is kept scaled up by 2^DSP_IIR_SHIFT so small steps are not lost.
+ *   Time constant is about 2^DSP_IIR_SHIFT samples.
+ *   Limit: largest input * 2^DSP_IIR_SHIFT < 65536 (e.g. 12-bit input, shift 4)
+ *
+ * DSP_MEDIAN3 / DSP_MEDIAN5
+ *   Median of the last 3 or 5 samples, removes single (or double) sample
+ *   spikes without smearing steps like an average does.
+ *
+ * Worst case of DSP_update(): no filter has a loop, so each has one longest
+ * path, taken when every compare-and-swap swaps. DSP_bench() times exactly
+ * that path:
+ *   type                worst path                      window timed
+ *   DSP_NONE            type switch only                -
+ *   DSP_MOVING_AVERAGE  16-bit add and subtract, shift  any (no branch)
+ *   DSP_IIR             two shifts, add and subtract    any (no branch)
+ *   DSP_MEDIAN3         3 compares, 2 swaps             {3, 1, 2}
+ *   DSP_MEDIAN5         7 compares, 3 swaps             {5, 1, 4, 2, 0}
+ * With {3, 1, 2}, a > b swaps and then b > c; with {5, 1, 4, 2, 0}, a > b
+ * and c > d swap, a <= c drops a, and r = 5 > e = 0 swaps. Each window is
+ * timed with the new sample at every index, so both sides of the index
+ * wrap are covered.
+ *
+ * The Tcy figures depend on the C18 version and its optimisation settings,
+ * so they are not written here: take them from DSP_bench() on the target,
+ * or from the MPLAB SIM stopwatch over DSP_update() with the windows above,
+ * and note them here with the settings used. adcpot_music.c keeps the
+ * DSP_bench() results in dsp_cost[]. Budget the ISR with them, e.g. at
+ * 10MHz (Tcy = 400ns) a filter run at 4kHz (250us per sample) has 625 Tcy
+ * per sample for everything.
+ */
+
+#ifndef DSP_MA_SHIFT
+#define DSP_MA_SHIFT (3) // 8 sample window
+#endif
+#define DSP_MA_SIZE (1 << DSP_MA_SHIFT)
+#define DSP_MA_MASK (DSP_MA_SIZE - 1)
+
+#ifndef DSP_IIR_SHIFT
+#define DSP_IIR_SHIFT (3) // alpha = 1/8
+#endif
+
+#define DSP_NONE           (0)
+#define DSP_MOVING_AVERAGE (1)
+#define DSP_IIR            (2)
+#define DSP_MEDIAN3        (3)
+#define DSP_MEDIAN5        (4)
+
+typedef struct {
+    UINT8 type;
+    UINT8 index;
+    UINT16 acc; // Running sum (moving average) or scaled output (IIR)
+    UINT16 buf[DSP_MA_SIZE > 5 ? DSP_MA_SIZE : 5];
+} DSP_Filter;
+
+// Function prototype
+void DSP_init(DSP_Filter *f, UINT8 type, UINT16 initial);
+UINT16 DSP_update(DSP_Filter *f, UINT16 x);
+UINT16 DSP_median3(UINT16 a, UINT16 b, UINT16 c);
+UINT16 DSP_bench(UINT8 type, UINT16 (*now)(void));
+
+
+void DSP_init(DSP_Filter *f, UINT8 type, UINT16 initial) {
+    /* Start the filter as if it had seen `initial` forever,
+     * so there is no start-up ramp from zero
+     */
+    UINT8 i;
+    f->type = type;
+    f->index = 0;
+    for (i = 0; i < sizeof(f->buf) / sizeof(f->buf[0]); i++) {
+        f->buf[i] = initial;
+    }
+    if (type == DSP_IIR) {
+        f->acc = initial << DSP_IIR_SHIFT;
+    } else {
+        f->acc = initial << DSP_MA_SHIFT;
+    }
+}
+
+UINT16 DSP_median3(UINT16 a, UINT16 b, UINT16 c) {
+    if (a > b) {
+        UINT16 t = a; a = b; b = t; // a <= b
+    }
+    if (b > c) {
+        b = c; // b = min(b, c)
+    }
+    return (a > b) ? a : b; // max(a, min(b, c))
+}
+
+UINT16 DSP_update(DSP_Filter *f, UINT16 x) {
+    UINT8 i = f->index;
+
+    switch (f->type) {
+        case DSP_MOVING_AVERAGE:
+            f->acc += x - f->buf[i]; // Add newest, drop oldest
+            f->buf[i] = x;
+            f->index = (i + 1) & DSP_MA_MASK;
+            return f->acc >> DSP_MA_SHIFT;
+
+        case DSP_IIR:
+            f->acc += x - (f->acc >> DSP_IIR_SHIFT);
+            return f->acc >> DSP_IIR_SHIFT;
+
+        case DSP_MEDIAN3:
+            f->buf[i] = x;
+            f->index = (i >= 2) ? 0 : i + 1;
+            return DSP_median3(f->buf[0], f->buf[1], f->buf[2]);
+
+        case DSP_MEDIAN5: {
+            /* Median of 5 with 7 compares and no sorting of the window:
+             * 1. Sort the pairs (a, b) and (c, d)
+             * 2. The smaller of a and c has 3 values above it, so it can
+             *    not be the median: drop it, keeping its pair partner
+             * 3. The median is now the 2nd smallest of the 4 left, which
+             *    are the sorted pair (p, q) and the sorted pair (r, e)
+             */
+            UINT16 a, b, c, d, e, p, q, r, t;
+            f->buf[i] = x;
+            f->index = (i >= 4) ? 0 : i + 1;
+            a = f->buf[0]; b = f->buf[1]; c = f->buf[2]; d = f->buf[3]; e = f->buf[4];
+            if (a > b) { t = a; a = b; b = t; } // a <= b
+            if (c > d) { t = c; c = d; d = t; } // c <= d
+            if (a <= c) {
+                p = c; q = d; r = b; // drop a
+            } else {
+                p = a; q = b; r = d; // drop c
+            }
+            if (r > e) { t = r; r = e; e = t; } // r <= e
+            p = (p > r) ? p : r; // 2nd smallest = min(max(p, r), min(q, e))
+            q = (q < e) ? q : e;
+            return (p < q) ? p : q;
+        }
+
+        default:
+            return x;
+    }
+}
+
+UINT16 DSP_bench(UINT8 type, UINT16 (*now)(void)) {
+    /* Worst DSP_update() of `type`, in ticks of now() (a free-running
+     * timer at Tcy, read without side effects), on the windows that make
+     * every compare-and-swap swap (see the top of this file).
+     * Call with interrupts off; DSP_init() costs are not included.
+     */
+    DSP_Filter f;
+    UINT16 t0, t1, empty, d, worst = 0;
+    UINT8 i, n;
+
+    t0 = now();
+    t1 = now();
+    empty = t1 - t0; // The timer reads themselves
+
+    n = (type == DSP_MEDIAN3) ? 3 : 5;
+    for (i = 0; i < n; i++) {
+        DSP_init(&f, type, 0);
+        if (type == DSP_MEDIAN3) {
+            f.buf[0] = 3000; f.buf[1] = 1000; f.buf[2] = 2000;
+        } else {
+            f.buf[0] = 4000; f.buf[1] = 800; f.buf[2] = 3200; f.buf[3] = 1600; f.buf[4] = 0;
+        }
+        f.index = i; // The new sample lands at i, with the same value
+        t0 = now();
+        DSP_update(&f, f.buf[i]);
+        t1 = now();
+        d = t1 - t0 - empty;
+        if (d > worst) {
+            worst = d;
+        }
+    }
+    return worst;
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef SNAP_LIB_H
+#define SNAP_LIB_H
+
+#include <GenericTypeDefs.h>
+
+/* Whole 16 and 32-bit values from the ISR to main, without masking
+ *
+ * The PIC18 moves one byte at a time, so main copying a UINT16 or UINT32
+ * the ISR writes can get some bytes from before an update and some from
+ * after it. A Snap16/Snap32 holds the value with a sequence count:
+ *   the writer adds 1 to seq (odd: being written), writes the value, then
+ *   adds 1 again (even: done)
+ *   the reader reads seq, the value, then seq again, and reads once more
+ *   if seq was odd or has moved
+ * An interrupt in the middle of a read costs one more read, nothing else,
+ * so the ISR latency is not touched and interrupts are never turned off.
+ *
+ * The writer must be the higher priority side (the ISR writes, main
+ * reads). A reader that interrupts a writer would wait for ever.
+ *
+ * seq also tells whether there is a new value: SnapXX_readNew() is TRUE
+ * when the value was written since the caller's `seen` count (seq wraps
+ * after 128 writes, so read at least that often).
+ */
+
+typedef struct {
+    volatile UINT8 seq;
+    volatile UINT16 value;
+} Snap16;
+
+typedef struct {
+    volatile UINT8 seq;
+    volatile UINT32 value;
+} Snap32;
+
+// Function prototype
+void Snap16_write(Snap16 *s, UINT16 v);
+UINT16 Snap16_read(Snap16 *s);
+BOOL Snap16_readNew(Snap16 *s, UINT16 *v, UINT8 *seen);
+void Snap32_write(Snap32 *s, UINT32 v);
+UINT32 Snap32_read(Snap32 *s);
+BOOL Snap32_readNew(Snap32 *s, UINT32 *v, UINT8 *seen);
+
+
+//----------------------------------------------------------------------------
+// 16-bit
+
+void Snap16_write(Snap16 *s, UINT16 v) {
+    /* From the ISR */
+    s->seq++;
+    s->value = v;
+    s->seq++;
+}
+
+BOOL Snap16_readNew(Snap16 *s, UINT16 *v, UINT8 *seen) {
+    /* From main. TRUE if written since *seen, which is updated */
+    UINT8 seq;
+    do {
+        seq = s->seq;
+        *v = s->value;
+    } while ((seq & 1) || seq != s->seq); // Written meanwhile, again
+    if (seq == *seen) {
+        return FALSE;
+    }
+    *seen = seq;
+    return TRUE;
+}
+
+UINT16 Snap16_read(Snap16 *s) {
+    UINT16 v;
+    UINT8 seen = 0;
+    Snap16_readNew(s, &v, &seen);
+    return v;
+}
+
+//----------------------------------------------------------------------------
+// 32-bit
+
+void Snap32_write(Snap32 *s, UINT32 v) {
+    /* From the ISR */
+    s->seq++;
+    s->value = v;
+    s->seq++;
+}
+
+BOOL Snap32_readNew(Snap32 *s, UINT32 *v, UINT8 *seen) {
+    /* From main. TRUE if written since *seen, which is updated */
+    UINT8 seq;
+    do {
+        seq = s->seq;
+        *v = s->value;
+    } while ((seq & 1) || seq != s->seq); // Written meanwhile, again
+    if (seq == *seen) {
+        return FALSE;
+    }
+    *seen = seq;
+    return TRUE;
+}
+
+UINT32 Snap32_read(Snap32 *s) {
+    UINT32 v;
+    UINT8 seen = 0;
+    Snap32_readNew(s, &v, &seen);
+    return v;
+}
+
+#endif
@@ -2,10 +2,11 @@
  * PICDEM 2 PLUS DEMO BOARD
  * PIC18F4520
  * 
- * A music tone will be produced for the buzzer on RC1,
+ * A music tone will be produced for the buzzer on RC2,
  * and its tone varies linearly with the pot on RA0.
  *
- * A PWM waveform is produced using CPP2 on RC1.
+ * A PWM waveform is produced using CPP1 on RC2 (jumper J9
+ * connects the buzzer). CCP2 is used to time the ADC.
  * The frequency of the tone is linearly interpolated
  * according to the ADC value on RA0 pot.
  *
@@ -13,77 +14,140 @@
  * to maintain the same duty cycle regardless of the
  * PWM period.
  *
+ * The ADC is run by the scan engine in ADC-Lib.h with
+ * 16x oversampling, giving a 12-bit pot reading.
+ * More channels can be added to ADC_SCAN_LIST.
+ *
+ * ADCS and ACQT are worked out from FOSC by ADC-Lib.h
+ * (10MHz -> FOSC/8, 4 TAD acquisition).
+ *
+ * The pot reading goes through a single-pole IIR low-pass
+ * in the ADC ISR, so the tone no longer warbles.
+ *
+ * Each conversion is started by the CCP2 special event
+ * trigger (Timer3) at exactly ADC_SAMPLE_RATE, so the
+ * ISR only stores the result.
+ *
+ * The main loop idles (Power-Lib.h) between interrupts and
+ * only works out a new tone when there is a new decimated
+ * pot reading (Snap-Lib.h, read whole without masking the
+ * A/D interrupt) and it changed.
+ * IDLE, not SLEEP, as Timer2/3 must keep running.
+ *
+ * Interrupts go through Irq-Lib.h: the A/D result is stored
+ * at high priority, the Timer1 statistics are low.
+ *
+ * The A/D handler is timed with Prof-Lib.h (Timer0, as Timer3
+ * is the trigger): latency from the end of the conversion,
+ * duration and CPU load go to `prof_adc` and `prof_load` for
+ * the watch window, and RB1 is high while it runs. At start-up
+ * DSP_bench() measures the worst DSP_update() of each filter
+ * type into `dsp_cost` (Tcy), to budget the ISR with.
+ *
  * The clock is set to HS with a 10MHz crystal (Fosc = 10MHz)
  */
 
 #include <p18f4520.h>
 #include <GenericTypeDefs.h>
 
+#define FOSC (10000000UL) // 10MHz HS mode
+#include "ADC-Lib.h"
+#include "Power-Lib.h"
+#define IRQ_HIGH_MATH // ADC_isr() runs the filter maths
+#include "Irq-Lib.h"
+#define PROF_ENABLE // Comment out to take the instrumentation out
+#define PROF_TIMER0
+#define PROF_PINS LATB
+#define PROF_PIN(src) (2 << (src)) // RB1, RB0 is the A/D LED
+#define PROF_SOURCES (1)
+#include "Prof-Lib.h"
+
+// Profiled interrupt sources
+#define PROF_ADC (0)
+
+// Tcy from the CCP2 trigger to ADIF: acquisition, conversion and discharge
+#define ADC_CONV_TCY ((ADC_ACQT_TAD + 12) * ADC_TAD_DIV / 4)
+
+#define ADC_SAMPLE_RATE (4000) // 4kHz -> 250Hz decimated pot reading
+
 void main(void);
 void setPWMFrequency(float freq);
-void setPWMDutyCycleCCP2(int pwm_percentage);
-void InterruptHandlerHigh();
+void setPWMDutyCycleCCP1(int pwm_percentage);
+void onADC(void);
+UINT16 sinceConversion(void);
+UINT16 timer0Now(void);
+
+// Channels converted in turn, index 0 is the pot on AN0
+const UINT8 ADC_SCAN_LIST[] = { 0 };
+#define ADC_POT (0)
 
-UINT16 ADCResult = 0;
+PowerStats power;
+ProfStats prof_adc;
+UINT16 prof_load; // Permille
+UINT16 dsp_cost[DSP_MEDIAN5 + 1]; // Worst DSP_update() per type, Tcy
 
 void main(void) {
-    // Output LED on RB0
+    UINT16 pot, last_pot = 0xFFFF;
+    UINT8 pot_seen = 0; // Sequence count of the last reading used
+    UINT8 i;
+
+    // Output LED on RB0, profiling pin on RB1
     TRISBbits.TRISB0 = 0;
+    TRISBbits.TRISB1 = 0;
+    Prof_setup(); // Timer0
+    for (i = DSP_NONE; i <= DSP_MEDIAN5; i++) {
+        dsp_cost[i] = DSP_bench(i, timer0Now); // Interrupts are still off
+    }
 
     /***************************************************************************/
     // Setup ADC on RA0
     /***************************************************************************/
-    // Setup input on RA0
-    TRISAbits.TRISA0 = 1;
-    
-    // 1. Configure the A/D module:
-    ADCON0bits.CHS = 0b0000; // Analog Channel Select RA0/AN0
-    
-    ADCON1bits.PCFG = 0b1110; // AN0 as analog input
-    ADCON1bits.VCFG1 = 0; // Vss as Vref-
-    ADCON1bits.VCFG0 = 0; // Vdd as Vref+
+    // 1. Configure the A/D module (pins, PCFG, ADCON2):
+    ADC_setupScan(ADC_SCAN_LIST, sizeof(ADC_SCAN_LIST), ADC_OVERSAMPLE_16X);
+    ADC_attachFilter(ADC_POT, DSP_IIR); // 12-bit input, 1/8 -> 15-bit state
     
-    ADCON2bits.ADFM = 1; // Right Justified
-    ADCON2bits.ACQT = 0b001; // 001 = 2 TAD Acquisition Time
-    ADCON2bits.ADCS = 0b001; // A/D Conversion Clock -> 001 = FOSC/8
-    
-    ADCON0bits.ADON = 1; // 1 = A/D Converter module is enabled
-    
-    // 2. Configure A/D interrupt (if desired):
-    PIR1bits.ADIF = 0; // Clear ADIF bit
-    PIE1bits.ADIE = 1; // Set ADIE bit 
-    INTCONbits.GIE = 1; // Set GIE bit 
-    INTCONbits.PEIE = 1; // Set peripheral bit 
-    
-    // 4. Start conversion:
-    ADCON0bits.GO = 1; // Set GO/DONE bit (ADCON0 register)
+    // 2. Configure A/D interrupt and start the CCP2 trigger:
+    Irq_setup();
+    Irq_register(IRQ_AD, onADC, IRQ_HIGH);
+    Irq_register(IRQ_TMR1, Power_isr, IRQ_LOW);
+    Power_setup(); // Timer1 time base for the idle statistics
+    Irq_enable(); // Set GIEH and GIEL bits
+    ADC_startTriggered(ADC_SAMPLE_RATE);
 
     /***************************************************************************/
-    // Setup PWM on RC1
+    // Setup PWM on RC2
     /***************************************************************************/
-    // Setup output on RA0
-    TRISCbits.RC1 = 0;
-
     // 1. Set the PWM period by writing to the PR2 register.
     setPWMFrequency(1046.50);
     
     // 2. Set the PWM duty cycle by writing to the CCPRxL register and CCPxCON<5:4> bits.
-    setPWMDutyCycleCCP2(10); // Set PWM duty cycle
+    setPWMDutyCycleCCP1(10); // Set PWM duty cycle
     
     // 3. Make the CCPx pin an output by clearing the appropriate TRIS bit.
-    TRISCbits.RC1 = 0; // Set RC1 to output: RC1/T1OSI/CCP2(1)
+    TRISCbits.TRISC2 = 0; // Set RC2 to output: RC2/CCP1/P1A
     
     // 4. Set up TMR2
     T2CONbits.T2CKPS = 0b10; // 1x = Prescaler is 16 
     T2CONbits.TMR2ON = 1; // 1 = Timer2 is on
     
     // 5. Configure the CCPx module for PWM operation.
-    CCP2CONbits.CCP2M = 0b1100; // CCP2 as PWM mode -> 11xx = PWM mode
+    CCP1CONbits.CCP1M = 0b1100; // CCP1 as PWM mode -> 11xx = PWM mode
     
     while (1) {
-        // Range of freq is 1046.50 (C6) to 2093.00 (C7)
-        float freq = (ADCResult / 1024.0 * 1046.5) + 1046.50;
-        setPWMFrequency(freq);
+        // Idle until the next interrupt (A/D at ADC_SAMPLE_RATE)
+        INTCONbits.GIE = 0;
+        Power_idle(POWER_IDLE);
+        INTCONbits.GIE = 1; // Pending ISR runs here
+
+        if (ADC_readNew(ADC_POT, &pot, &pot_seen) && pot != last_pot) {
+            // Range of freq is 1046.50 (C6) to 2093.00 (C7)
+            float freq = ((float) pot / ADC_getFullScale() * 1046.5) + 1046.50;
+            setPWMFrequency(freq);
+            last_pot = pot;
+            Power_read(&power);
+            Prof_read(PROF_ADC, &prof_adc);
+            prof_load = Prof_load();
+        }
     }
 }
 
@@ -101,7 +165,6 @@ void main(void) {
  *   (1 / 0.25 * Prescale / FOSC)^-1 = freq max
  */
 
-#define FOSC (10e6) // 10MHz HS mode
 #define PWM_PRESCALE (16)
 #define round(x) ((x) + 0.5)
 //Calculated for 10MHz, 16 prescaler
@@ -111,7 +174,7 @@ void setPWMFrequency(float freq) {
     PR2 = 0.25  * FOSC / freq / PWM_PRESCALE - 1;
 }
 
-void setPWMDutyCycleCCP2(int pwm_percentage) {
+void setPWMDutyCycleCCP1(int pwm_percentage) {
     /* Calculation for PWM Duty Cycle
      *   PWM Duty Cycle = (CCPRXL:CCPXCON<5:4>)  TOSC  (TMR2 Prescale Value)
      *   PWM Period = [(PR2) + 1]  4  TOSC  (TMR2 Prescale Value)
@@ -122,33 +185,35 @@ void setPWMDutyCycleCCP2(int pwm_percentage) {
     int pwm_period = PR2;
     // round off the float
     int pwm_duty_cycle = round( (pwm_percentage * 0.01f) * (pwm_period + 1) * 4 ); 
-    CCP2CONbits.DC2B = 0b11 & pwm_duty_cycle; // DCxB<1:0>: bits 0, 1
-    CCPR2L = pwm_duty_cycle >> 2;
+    CCP1CONbits.DC1B = 0b11 & pwm_duty_cycle; // DCxB<1:0>: bits 0, 1
+    CCPR1L = pwm_duty_cycle >> 2;
 }
 
 
-#pragma code InterruptVectorHigh = 0x08
-void InterruptVectorHigh (void) {
-    _asm
-        goto InterruptHandlerHigh //jump to interrupt routine
-    _endasm
-}
-
 //----------------------------------------------------------------------------
-// High priority interrupt routine
-
-#pragma code
-#pragma interrupt InterruptHandlerHigh
-void InterruptHandlerHigh() {
-    if (PIR1bits.ADIF) {
-        if (!ADCON0bits.GO_DONE) { // if done conversion
-            PIR1bits.ADIF = 0; // Clear ADIF bit
-            // Alternatively: ADCResult = ADRES;
-            ADCResult = ((int) ADRESH) << 8; // Must cast as the register is 8-bits wide
-            ADCResult |= ADRESL;
-            // result is loaded into the ADRESH:ADRESL register pair
-            ADCON0bits.GO = 1;
-        }
-        LATBbits.LATB0 = !LATBbits.LATB0; //toggle LED on RB0
+// Interrupt handlers, called from Irq-Lib.h
+
+void onADC(void) {
+    PROF_ENTER(PROF_ADC)
+    PROF_LATENCY(PROF_ADC, sinceConversion())
+    if (!ADCON0bits.GO_DONE) { // if done conversion
+        // Store result and switch channel, CCP2 starts the next one
+        ADC_isr();
     }
-}
\ No newline at end of file
+    LATBbits.LATB0 = !LATBbits.LATB0; //toggle LED on RB0
+    PROF_EXIT(PROF_ADC)
+}
+
+UINT16 sinceConversion(void) {
+    /* Tcy from ADIF to now: Timer3 restarted from 0 at the trigger */
+    UINT16 t = TMR3L; // Latches TMR3H
+    t |= (UINT16) TMR3H << 8;
+    t <<= T3CONbits.T3CKPS;
+    return (t > ADC_CONV_TCY) ? t - ADC_CONV_TCY : 0;
+}
+
+UINT16 timer0Now(void) {
+    /* Timer0 at Tcy (Prof-Lib.h, PROF_PRESCALE 1) */
+    UINT16 t = TMR0L; // Latches TMR0H
+    return t | ((UINT16) TMR0H << 8);
+}
@@ -19,56 +19,107 @@
  *
  * The clock is set to HS mode with a 10MHz crystal
  *     Fosc / 4 = 2.5MHz
+ *
+ * Period and frequency are worked out with integer maths only
+ * (Capture-Math.h), no float library is linked.
+ *
+ * Timer1 runs freely and is extended to 32 bits by its overflow
+ * interrupt (Capture-Lib.h). Each count is the difference of two
+ * capture timestamps, so it is cycle-exact whatever the interrupt
+ * latency, and periods above 65536 Tcy are measured too.
+ *
+ * The capture prescaler (every 1st/4th/16th edge) and the Timer1
+ * prescaler are picked at run time from the input frequency, so the
+ * CCP1 interrupt rate stays below CAPTURE_MAX_IRQ_HZ.
+ *
+ * The LCD shows the mean of each window of STATS_WINDOW periods
+ * (Capture-Stats.h), and the standard deviation and min/max spread
+ * of the period in place of the period every other refresh.
+ *
+ * Above about 16kHz even every 16th edge interrupts too often, so
+ * the signal is also counted on RA4/T0CKI over a 100ms gate
+ * (Counter-Lib.h), and CCP1 capture is turned off while the count
+ * is high. Wire the input to RA4 as well, through another 10k.
+ *
+ * With PULSE_MODE defined, CCP1 alternates between rising and
+ * falling edges instead, and the LCD shows the duty cycle and the
+ * high time, averaged over every pulse since the last refresh.
+ *
+ * The ISR is timed with Prof-Lib.h (Timer3, 1:8): every third
+ * display phase shows the CPU load and the latency/duration of
+ * the capture and counter code in us. RB1 and RB2 are high
+ * while each runs, for a scope.
  */
 
 #include <p18f4520.h>
 #include <GenericTypeDefs.h>
 #include <delays.h>
-#include "LCD-Lib.h"
 #include <stdio.h>
 
-#define CLK_CYCLE_FREQ (2.5e6) // Fosc / 4 = 2.5MHz
-#define CLK_CYCLE_TIME (400.0e-9) // Fosc / 4 -> -> Tcy = 400ns
+#define FOSC (10000000UL) // 10MHz HS mode -> Tcy = 400ns
+#include "LCD-Lib.h"
 
 /*  CCP1CONbits.CCP1M
     0100 = Capture mode, every falling edge
     0101 = Capture mode, every rising edge
     0110 = Capture mode, every 4th rising edge
-    0111 = Capture mode, every 16th rising edge */
-#define CCP_EDGE_CONFIG (0b111)
-#define CCP_EDGE_VALUE  (16.0)
+    0111 = Capture mode, every 16th rising edge
+    Auto-ranging scales every count to 16 edges at 1:1 */
+#define CAPTURE_EDGES   (16)
+#define CAPTURE_T1_PRESCALE (1)
+#define CAPTURE_MAX_IRQ_HZ (1000)
+// #define PULSE_MODE
+#define STATS_WINDOW (16) // Periods per statistics result
+#include "Capture-Math.h"
+#include "Capture-Stats.h"
+#include "Capture-Lib.h"
+#include "Counter-Lib.h"
+#define PROF_ENABLE // Comment out to take the instrumentation out
+#define PROF_PRESCALE (8) // Read at least every 105ms, main reads it every refresh
+#define PROF_PINS LATB
+#define PROF_PIN(src) (2 << (src)) // RB1, RB2, RB0 is the capture LED
+#define PROF_SOURCES (2)
+#include "Prof-Lib.h"
+
+// Profiled interrupt sources
+#define PROF_CAPTURE (0) // CCP1 and Timer1 overflow
+#define PROF_COUNTER (1) // CCP2 gate and Timer0 overflow
+
+#ifdef PROF_ENABLE
+#define REFRESH_CYCLE (75) // Period, jitter, ISR timing
+#else
+#define REFRESH_CYCLE (50) // Period, jitter
+#endif
 
 // Function Prototype
 void main(void);
 void InterruptHandlerHigh(void);
-
-UINT16 CCP1_Value = 0;
+UINT16 sinceCompare(UINT16 ccpr);
 
 void main(void) {
-    // LED on RB0
+    // LED on RB0, profiling pins on RB1:2
     TRISBbits.TRISB0 = 0;
+    TRISBbits.TRISB1 = 0;
+    TRISBbits.TRISB2 = 0;
+    Prof_setup(); // Timer3, before any interrupt
     
     /***************************************************************************/
     // Setup RC2/CCP1 and Timer1
     /***************************************************************************/
-    TRISCbits.TRISC2 = 1; // RC2 as input
-    
-    T3CONbits.T3CCP1 = 0; // Use Timer 1 for all CCP
-    T3CONbits.T3CCP2 = 0; // Use Timer 1 for all CCP
-    
-    CCP1CONbits.CCP1M = CCP_EDGE_CONFIG; // Set to CCP Capture mode
-    
     /* Enable global interrupts */
     INTCONbits.GIEH = 1;
     INTCONbits.GIEL = 1; 
     
-    /* CCP1 Interrupt */
-    PIE1bits.CCP1IE = 1; // Enable CCP1 interrupt
-    PIR1bits.CCP1IF = 0; // Clear flag
-    
-    /* Timer1 */
-    T1CONbits.T1CKPS = 0b00; // 1:1 Prescale value
-    T1CONbits.TMR1ON = 1; // 1 = Enables Timer1 
+#ifdef PULSE_MODE
+    /* CCP1 and Timer1 interrupts, alternating edges */
+    Capture_setupPulse();
+#else
+    /* CCP1 and Timer1 interrupts, auto-ranging prescalers */
+    Stats_setup(STATS_WINDOW);
+    Capture_setupAutoRange();
+    /* Timer0 edge counter, CCP2 gate on Timer1 */
+    Counter_setup();
+#endif
     
     /***************************************************************************/
     // Setup LCD
@@ -76,37 +127,103 @@ void main(void) {
     LCD_TRIS = 0;
     LCD_LAT_Vcc = 1; // Turn on LCD on the board
     
-    Delay1KTCYx(100); // Delay before initialising display
+    delay_ms(40); // Delay before initialising display
     LCD_setup();
     
     LCD_clearDisplay();
     LCD_returnHome();
     
     while (1) {
-        char buf[20], buf1[20];
-        float CCP_cycles = CCP1_Value / CCP_EDGE_VALUE;
+        char buf[28], buf1[28];
+        static UINT8 refresh = 0;
+#ifdef PULSE_MODE
+        UINT32 high, low, sum_high = 0, sum_low = 0;
+        UINT8 n = 0;
+        UINT16 duty;
         
-        // Period in ms (CCP cycles time * 10^3 to get period in millisec)
-        float period = CCP_cycles * CLK_CYCLE_TIME * 1e3;
-        UINT32 period_int = period;
-        UINT32 period_frac = (period - period_int) * 10000;
+        // Take every pulse the ISR stored since the last refresh
+        while (Capture_readPulse(&high, &low)) {
+            sum_high += high;
+            sum_low += low;
+            n++;
+        }
+        if (n > 0) {
+            UINT32 high_ns = Capture_ticksToNs(sum_high / n);
+            duty = Capture_dutyPermille(sum_high, sum_low);
+            
+            sprintf (buf, "D = %u.%u %%      ", duty / 10, duty % 10);
+            sprintf (buf1, "H = %lu.%04lu ms   ", high_ns / 1000000, (high_ns % 1000000) / 100);
+            
+            LCD_setCursor(0, 0);
+            LCD_puts(buf);
+            LCD_setCursor(1, 0);
+            LCD_puts(buf1);
+        }
+#else
+        static CaptureStats stats;
+        UINT32 count, period, period_int, period_frac, freq, freq_int, freq_frac;
+        UINT32 hz;
+        int len;
         
-        // Frequency in Hz
-        float freq = CLK_CYCLE_FREQ / CCP_cycles;
-        UINT32 freq_int = freq;
-        UINT32 freq_frac = (freq - freq_int) * 100;
+        if (++refresh >= REFRESH_CYCLE) {
+            refresh = 0;
+        }
+        if (counter_gate_mode) {
+            // Gate counting (Counter-Lib.h): whole Hz, period from 1/f
+            Counter_read(&hz);
+            stats.n = 0;
+            sprintf (buf, "f = %lu Hz     ", hz);
+            sprintf (buf1, "t = %lu ns     ", hz ? 1000000000UL / hz : 0UL);
+        } else {
+            if (Capture_read() == 0) {
+                stats.n = 0; // No signal, forget the last window
+            } else {
+                Stats_read(&stats);
+            }
+            // Mean of the last window, or the latest count until one is done
+            count = stats.n ? stats.mean : Capture_read();
         
-        //sprintf (buf, "CCP1 = %u     ", CCP1_Value); // Print CCP1 register value in decimal
-        //sprintf (buf, "CCP1 = %#06x", CCP1_Value); // Print CCP1 register value in hexadecimal
-        sprintf (buf, "f = %lu.%02lu Hz     ", freq_int, freq_frac);
-        sprintf (buf1, "t = %lu.%04lu ms     ", period_int, period_frac);
+            // Period in ns -> ms with 4 decimal places
+            period = Capture_periodNs(count);
+            period_int = period / 1000000;
+            period_frac = (period % 1000000) / 100;
+        
+            // Frequency in mHz -> Hz with 2 decimal places
+            freq = Capture_freqMilliHz(count);
+            freq_int = freq / 1000;
+            freq_frac = (freq % 1000) / 10;
+        
+            //sprintf (buf, "CCP1 = %lu     ", count); // Print capture count in decimal
+            //sprintf (buf, "CCP1 = %#010lx", count); // Print capture count in hexadecimal
+            sprintf (buf, "f = %lu.%02lu Hz     ", freq_int, freq_frac);
+            if (refresh >= 25 && refresh < 50 && stats.n) {
+                // Jitter: standard deviation and max - min of the period, in ns
+                len = sprintf (buf1, "s%lu r%lu ns", Capture_periodNs(stats.stddev),
+                               Capture_periodNs(stats.max - stats.min));
+                while (len < 16) {
+                    buf1[len++] = ' ';
+                }
+                buf1[16] = 0;
+            } else {
+                sprintf (buf1, "t = %lu.%04lu ms     ", period_int, period_frac);
+            }
+        }
+#ifdef PROF_ENABLE
+        // The ISRs may be 210ms apart (Timer1 at 1:8), over half a Timer3 wrap
+        Prof_load();
+        if (refresh >= 50) {
+            // ISR timing, capture then counter
+            Prof_report(refresh < 63 ? PROF_CAPTURE : PROF_COUNTER, buf, buf1);
+        }
+#endif
         
         LCD_setCursor(0, 0);
         LCD_puts(buf);
         LCD_setCursor(1, 0);
         LCD_puts(buf1);
+#endif
         
-        Delay10KTCYx(10);
+        delay_ms(40); // Refresh
     }
 }
 
@@ -125,16 +242,34 @@ void InterruptVectorHigh() {
 // High priority interrupt routine
 
 #pragma code
-#pragma interrupt InterruptHandlerHigh
+#pragma interrupt InterruptHandlerHigh save=PROD,section(".tmpdata"),section("MATH_DATA")
 
 void InterruptHandlerHigh() {
-    if (PIR1bits.CCP1IF) {                 
-        CCP1_Value = CCPR1; // Save CCP value
-        TMR1L = 0;
-        TMR1H = 0; // Reset timer value used for CCP
-        PIR1bits.CCP1IF = 0; //clear interrupt flag
-        LATB ^= 1; // (DEBUG) Toggle RB0 LED
+    Counter_latch(); // Gate end: Timer0 before anything else runs
+    if (PIR1bits.CCP1IF || PIR1bits.TMR1IF) {
+        PROF_ENTER(PROF_CAPTURE)
+        if (PIR1bits.CCP1IF) {
+            PROF_LATENCY(PROF_CAPTURE, sinceCompare(CCPR1))
+            LATB ^= 1; // (DEBUG) Toggle RB0 LED
+        }
+        Capture_isr(); // 32-bit timestamp, Timer1 keeps running
+        PROF_EXIT(PROF_CAPTURE)
+    }
+    if (PIR2bits.CCP2IF || INTCONbits.TMR0IF) {
+        PROF_ENTER(PROF_COUNTER)
+        if (PIR2bits.CCP2IF) {
+            PROF_LATENCY(PROF_COUNTER, sinceCompare(CCPR2))
+        }
+        Counter_isr(); // Gate end, Timer0 overflow
+        PROF_EXIT(PROF_COUNTER)
     }
 }
 
+UINT16 sinceCompare(UINT16 ccpr) {
+    /* Tcy from a CCP1 capture or CCP2 compare match to now, both on Timer1 */
+    UINT16 t = TMR1L; // Latches TMR1H
+    t |= (UINT16) TMR1H << 8;
+    return (t - ccpr) << T1CONbits.T1CKPS;
+}
+
 //----------------------------------------------------------------------------
\ No newline at end of file
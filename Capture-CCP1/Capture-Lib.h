@@ -0,0 +1,302 @@
+#ifndef CAPTURE_LIB_H
+#define CAPTURE_LIB_H
+
+#include <GenericTypeDefs.h>
+#include "Snap-Lib.h"
+
+/* Free-running CCP1 capture with a 32-bit Timer1
+ *
+ * Timer1 is never reset. Its overflow interrupt counts the upper 16 bits in
+ * software, so every capture becomes a 32-bit timestamp and the measured
+ * count is the difference between two timestamps:
+ *   - interrupt latency does not matter, as CCPR1 holds the capture time
+ *   - periods longer than 65536 ticks are measured correctly
+ *
+ * Capture and overflow at the same time:
+ *   When CCP1IF is served while TMR1IF is still pending, the overflow is not
+ *   in capture_t1_high yet. If the captured value is in the lower half
+ *   (bit 15 clear) the capture happened after the overflow, so the upper word
+ *   is taken as one more. A capture with bit 15 set happened just before the
+ *   wrap and keeps the old upper word. This holds while the ISR latency is
+ *   below 32768 Timer1 ticks.
+ *
+ * No signal: after CAPTURE_TIMEOUT_OVF overflows without a capture, the count
+ * is cleared to 0 and the next capture only restarts the timestamps.
+ *
+ * Auto-ranging (Capture_setupAutoRange):
+ *   The capture prescaler (CCP1M) and the Timer1 prescaler are switched at
+ *   run time from the measured period:
+ *     range | CCP1M            | Timer1 | count scaled by
+ *     ------|------------------|--------|----------------
+ *       0   | every rising     | 1:8    | x128
+ *       1   | every rising     | 1:1    | x16
+ *       2   | every 4th rising | 1:1    | x4
+ *       3   | every 16th rising| 1:1    | x1
+ *   A range goes up (more edges per capture) when captures come faster than
+ *   CAPTURE_MAX_IRQ_HZ, and down when they come slower than 1/8 of it, so
+ *   after a switch the new rate has a 2x margin each way. Range 0 is only
+ *   used for periods above CAPTURE_SLOW_TCY, to cut the Timer1 overflow
+ *   interrupts. A timeout also steps the range down, so slow signals are
+ *   found without waiting 16 periods.
+ *   Every count is scaled to "Tcy per 16 periods", so Capture-Math.h must
+ *   use CAPTURE_EDGES 16 and CAPTURE_T1_PRESCALE 1 and the reading stays
+ *   continuous over a range change. The first capture after a change only
+ *   restarts the timestamps.
+ *
+ * Capture_read() copies the count without holding off the interrupts: it
+ * is a Snap32 (Snap-Lib.h), read again if the ISR wrote it in between.
+ *
+ * Statistics:
+ *   When Capture-Stats.h is included before this file, every period count
+ *   is also passed to Stats_add() from the ISR.
+ *
+ * Pulse-width mode (Capture_setupPulse):
+ *   CCP1 is switched between every rising (0101) and every falling (0100)
+ *   edge after each capture. A rising edge closes the low time of the pulse
+ *   before it, so each high time is stored together with the low time that
+ *   follows it, which keeps the duty cycle right when it changes quickly.
+ *   Pairs go into a CAPTURE_PULSE_RING_SIZE ring buffer that the main loop
+ *   empties in batches with Capture_readPulse(). When it is full, new pairs
+ *   are dropped and counted in capture_pulse_lost.
+ *   The shortest high or low time is the time to switch the edge in the ISR
+ *   (a few us), a shorter one makes the pair span a whole extra period.
+ *
+ * FOSC (in Hz, as an integer) must be defined before including this file.
+ */
+
+#ifndef FOSC
+#error "FOSC must be defined before including Capture-Lib.h"
+#endif
+#ifndef CAPTURE_TIMEOUT_OVF
+#define CAPTURE_TIMEOUT_OVF (100) // 100 * 65536 / 2.5MHz = 2.6s at 10MHz
+#endif
+#ifndef CAPTURE_MAX_IRQ_HZ
+#define CAPTURE_MAX_IRQ_HZ (1000)
+#endif
+#ifndef CAPTURE_SLOW_TCY
+#define CAPTURE_SLOW_TCY (0x200000UL) // 2^21 Tcy = 0.84s at 10MHz
+#endif
+#ifndef CAPTURE_PULSE_RING_SIZE
+#define CAPTURE_PULSE_RING_SIZE (8) // Must be a power of 2
+#endif
+#define CAPTURE_MIN_TCY (FOSC / 4 / CAPTURE_MAX_IRQ_HZ)
+#define CAPTURE_RANGES (4)
+
+#define CAPTURE_MODE_PERIOD (0)
+#define CAPTURE_MODE_PULSE  (1)
+
+const UINT8 CAPTURE_RANGE_CCP1M[CAPTURE_RANGES] = { 0b0101, 0b0101, 0b0110, 0b0111 };
+const UINT8 CAPTURE_RANGE_T1CKPS[CAPTURE_RANGES] = { 0b11, 0b00, 0b00, 0b00 };
+const UINT8 CAPTURE_RANGE_T1SHIFT[CAPTURE_RANGES] = { 3, 0, 0, 0 }; // log2 Timer1 prescale
+const UINT8 CAPTURE_RANGE_SHIFT[CAPTURE_RANGES] = { 7, 4, 2, 0 }; // log2 scale to 16 edges, 1:1
+const UINT8 CAPTURE_RANGE_EDGES[CAPTURE_RANGES] = { 1, 1, 4, 16 };
+
+volatile UINT16 capture_t1_high = 0; // Timer1 bits 16:31
+Snap32 capture_count = { 0, 0 }; // Timer1 ticks between the last 2 captures
+UINT32 capture_last = 0;
+BOOL capture_started = FALSE;
+UINT8 capture_idle = 0;
+BOOL capture_autorange = FALSE;
+volatile UINT8 capture_range = CAPTURE_RANGES - 1;
+
+UINT8 capture_mode = CAPTURE_MODE_PERIOD;
+UINT32 capture_high = 0; // High time waiting for its low time
+BOOL capture_have_high = FALSE;
+UINT32 capture_pulse_high[CAPTURE_PULSE_RING_SIZE];
+UINT32 capture_pulse_low[CAPTURE_PULSE_RING_SIZE];
+volatile UINT8 capture_pulse_head = 0; // Written by the ISR only
+volatile UINT8 capture_pulse_tail = 0; // Written by main only
+volatile UINT16 capture_pulse_lost = 0;
+
+// Function prototype
+void Capture_setup(UINT8 ccp1m, UINT8 t1_prescale_bits);
+void Capture_setupAutoRange(void);
+void Capture_setupPulse(void);
+void Capture_setRange(UINT8 range);
+void Capture_checkRange(UINT32 ticks);
+void Capture_pulseEdge(UINT32 ticks);
+void Capture_isr(void);
+BOOL Capture_readPulse(UINT32 *high, UINT32 *low);
+UINT32 Capture_read(void);
+UINT8 Capture_getEdges(void);
+
+
+void Capture_setup(UINT8 ccp1m, UINT8 t1_prescale_bits) {
+    TRISCbits.TRISC2 = 1; // RC2 as input
+
+    T3CONbits.T3CCP1 = 0; // Use Timer 1 for all CCP
+    T3CONbits.T3CCP2 = 0; // Use Timer 1 for all CCP
+
+    CCP1CONbits.CCP1M = ccp1m; // Set to CCP Capture mode
+
+    /* Timer1, free running */
+    T1CONbits.RD16 = 1; // 16-bit read/write
+    T1CONbits.TMR1CS = 0; // Internal clock (FOSC/4)
+    T1CONbits.T1CKPS = t1_prescale_bits;
+
+    PIR1bits.CCP1IF = 0; // Clear flag
+    PIR1bits.TMR1IF = 0; // Clear flag
+    PIE1bits.CCP1IE = 1; // Enable CCP1 interrupt
+    PIE1bits.TMR1IE = 1; // Enable Timer1 overflow interrupt
+    INTCONbits.PEIE = 1; // Enable peripheral interrupts
+
+    T1CONbits.TMR1ON = 1; // 1 = Enables Timer1
+}
+
+void Capture_setupAutoRange(void) {
+    capture_autorange = TRUE;
+    capture_range = CAPTURE_RANGES - 1; // Start with every 16th edge
+    Capture_setup(CAPTURE_RANGE_CCP1M[capture_range], CAPTURE_RANGE_T1CKPS[capture_range]);
+}
+
+void Capture_setupPulse(void) {
+    /* Every edge, Timer1 1:1, starting with a rising edge */
+    capture_mode = CAPTURE_MODE_PULSE;
+    capture_autorange = FALSE;
+    capture_have_high = FALSE;
+    Capture_setup(0b0101, 0b00);
+}
+
+void Capture_pulseEdge(UINT32 ticks) {
+    /* ticks = time since the previous (opposite) edge. Called from the ISR
+     * after a capture, with CCP1M still set to the edge just captured.
+     */
+    if (CCP1CONbits.CCP1M == 0b0101) {
+        // Rising edge: ticks is the low time after capture_high
+        if (capture_have_high) {
+            UINT8 head = capture_pulse_head;
+            UINT8 next = (head + 1) & (CAPTURE_PULSE_RING_SIZE - 1);
+            if (next == capture_pulse_tail) {
+                capture_pulse_lost++; // Main loop too slow, drop the pair
+            } else {
+                capture_pulse_high[head] = capture_high;
+                capture_pulse_low[head] = ticks;
+                capture_pulse_head = next;
+            }
+            capture_have_high = FALSE;
+        }
+        CCP1CONbits.CCP1M = 0b0100; // Next: falling edge
+    } else {
+        // Falling edge: ticks is the high time
+        capture_high = ticks;
+        capture_have_high = TRUE;
+        CCP1CONbits.CCP1M = 0b0101; // Next: rising edge
+    }
+    PIR1bits.CCP1IF = 0; // Mode change may set a false flag
+}
+
+BOOL Capture_readPulse(UINT32 *high, UINT32 *low) {
+    /* Take the oldest high/low pair in Timer1 ticks, FALSE when empty */
+    UINT8 tail = capture_pulse_tail;
+    if (tail == capture_pulse_head) {
+        return FALSE;
+    }
+    *high = capture_pulse_high[tail];
+    *low = capture_pulse_low[tail];
+    capture_pulse_tail = (tail + 1) & (CAPTURE_PULSE_RING_SIZE - 1); // Free the slot last
+    return TRUE;
+}
+
+void Capture_setRange(UINT8 range) {
+    /* Changing the capture prescaler can raise a false interrupt, so CCP1
+     * is turned off first (datasheet 15.2.4). Called from the ISR.
+     */
+    CCP1CON = 0; // 0000 = Capture/Compare/PWM off, clears the prescaler
+    CCP1CONbits.CCP1M = CAPTURE_RANGE_CCP1M[range];
+    T1CONbits.T1CKPS = CAPTURE_RANGE_T1CKPS[range];
+    PIR1bits.CCP1IF = 0;
+    capture_range = range;
+    capture_started = FALSE; // Timestamps are in the old units
+}
+
+void Capture_checkRange(UINT32 ticks) {
+    /* ticks = Timer1 ticks between 2 captures in the current range */
+    UINT8 range = capture_range;
+    UINT32 tcy = ticks << CAPTURE_RANGE_T1SHIFT[range];
+
+    if (range == 0) {
+        if (tcy < CAPTURE_SLOW_TCY / 4) {
+            Capture_setRange(1);
+        }
+    } else if (range == 1 && tcy > CAPTURE_SLOW_TCY) {
+        Capture_setRange(0);
+    } else if (range < CAPTURE_RANGES - 1 && tcy < CAPTURE_MIN_TCY) {
+        Capture_setRange(range + 1); // Too many interrupts
+    } else if (range > 1 && tcy > CAPTURE_MIN_TCY * 8) {
+        Capture_setRange(range - 1); // Faster updates, still 2x under the limit
+    }
+}
+
+UINT8 Capture_getEdges(void) {
+    /* Input periods per capture in the current range */
+    return CAPTURE_RANGE_EDGES[capture_range];
+}
+
+void Capture_isr(void) {
+    /* Call from the ISR when CCP1IF or TMR1IF is set.
+     * The capture is handled first so a pending overflow can be checked.
+     */
+    if (PIR1bits.CCP1IF) {
+        UINT16 low = CCPR1; // Capture time, held until the next edge
+        UINT16 high = capture_t1_high;
+        UINT32 stamp;
+
+        PIR1bits.CCP1IF = 0; //clear interrupt flag
+        if (PIR1bits.TMR1IF && !(low & 0x8000)) {
+            high++; // Overflowed before this capture, not counted yet
+        }
+        stamp = ((UINT32) high << 16) | low;
+
+        capture_idle = 0;
+        if (capture_mode == CAPTURE_MODE_PULSE) {
+            if (capture_started) {
+                Capture_pulseEdge(stamp - capture_last);
+            } else {
+                // First edge: just follow it with the opposite one
+                CCP1CONbits.CCP1M = (CCP1CONbits.CCP1M == 0b0101) ? 0b0100 : 0b0101;
+                PIR1bits.CCP1IF = 0;
+            }
+            capture_last = stamp;
+            capture_started = TRUE;
+        } else if (capture_started) {
+            UINT32 ticks = stamp - capture_last;
+            capture_last = stamp;
+            if (capture_autorange) {
+                UINT8 shift = CAPTURE_RANGE_SHIFT[capture_range];
+                if (ticks > (0xFFFFFFFFUL >> shift)) {
+                    ticks = 0xFFFFFFFFUL >> shift; // Saturate
+                }
+                Capture_checkRange(ticks);
+                ticks <<= shift; // Tcy per 16 periods
+            }
+            Snap32_write(&capture_count, ticks);
+#ifdef CAPTURE_STATS_H
+            Stats_add(ticks);
+#endif
+        } else {
+            capture_last = stamp;
+            capture_started = TRUE;
+        }
+    }
+
+    if (PIR1bits.TMR1IF) {
+        PIR1bits.TMR1IF = 0; //clear interrupt flag
+        capture_t1_high++;
+        if (++capture_idle >= CAPTURE_TIMEOUT_OVF) {
+            capture_idle = 0;
+            Snap32_write(&capture_count, 0); // No signal
+            capture_started = FALSE;
+            capture_have_high = FALSE;
+            if (capture_autorange && capture_range > 0) {
+                Capture_setRange(capture_range - 1); // Look for a slower signal
+            }
+        }
+    }
+}
+
+UINT32 Capture_read(void) {
+    /* 32-bit value written by the ISR, all bytes from the same capture */
+    return Snap32_read(&capture_count);
+}
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef CAPTURE_MATH_H
+#define CAPTURE_MATH_H
+
+#include <GenericTypeDefs.h>
+
+/* Integer-only period and frequency from a capture count
+ *
+ * A capture count is the number of Timer1 ticks seen over CAPTURE_EDGES
+ * periods of the input (CCP1M = every 1st, 4th or 16th rising edge).
+ *
+ *   Timer1 tick rate  = FOSC / 4 / CAPTURE_T1_PRESCALE
+ *   Period            = count / (tick rate * edges)
+ *   Frequency         = (tick rate * edges) / count
+ *
+ * Both scale factors are folded into constants at compile time, so each
+ * result costs one 32-bit multiply or division plus a remainder step, with
+ * no float library. The same count always gives the same result.
+ *
+ * FOSC (in Hz, as an integer) must be defined before including this file.
+ */
+
+#ifndef FOSC
+#error "FOSC must be defined before including Capture-Math.h"
+#endif
+#ifndef CAPTURE_T1_PRESCALE
+#define CAPTURE_T1_PRESCALE (1)
+#endif
+#ifndef CAPTURE_EDGES
+#define CAPTURE_EDGES (16)
+#endif
+
+/* Timer1 ticks per second of input period, edge count included
+ *   10MHz, 1:1, 16 edges -> 2.5MHz * 16 = 40,000,000
+ */
+#define CAPTURE_FREQ_NUM ((UINT32) FOSC / 4 / CAPTURE_T1_PRESCALE * CAPTURE_EDGES)
+
+/* Nanoseconds per count in Q8 fixed point
+ *   1e9 / (tick rate * edges) * 256
+ *   10MHz, 1:1, 16 edges -> 25ns * 256 = 6400 (exact)
+ * Exact whenever FOSC is a multiple of 4kHz * prescale.
+ */
+#define CAPTURE_NS_Q8 (256000000UL / (FOSC / 4000 / CAPTURE_T1_PRESCALE) / CAPTURE_EDGES)
+
+/* Nanoseconds per single Timer1 tick in Q8 (pulse widths, no edge factor) */
+#define CAPTURE_TICK_NS_Q8 (256000000UL / (FOSC / 4000 / CAPTURE_T1_PRESCALE))
+
+// Function prototype
+UINT32 Capture_mulQ8(UINT32 count, UINT32 q8);
+UINT32 Capture_periodNs(UINT32 count);
+UINT32 Capture_ticksToNs(UINT32 ticks);
+UINT32 Capture_freqMilliHz(UINT32 count);
+UINT16 Capture_dutyPermille(UINT32 high, UINT32 low);
+
+
+UINT32 Capture_mulQ8(UINT32 count, UINT32 q8) {
+    /* count * q8 / 256
+     * Split in two so no intermediate overflows before the result does.
+     * Saturates at 0xFFFFFFFF.
+     */
+    UINT32 high = count >> 8;
+    if (high > 0xFFFFFFFFUL / q8) {
+        return 0xFFFFFFFFUL;
+    }
+    return high * q8 + (((count & 0xFF) * q8) >> 8);
+}
+
+UINT32 Capture_periodNs(UINT32 count) {
+    /* period_ns = count * CAPTURE_NS_Q8 / 256, saturates at ~4.29s */
+    return Capture_mulQ8(count, CAPTURE_NS_Q8);
+}
+
+UINT32 Capture_ticksToNs(UINT32 ticks) {
+    /* Length of a single pulse measured in Timer1 ticks */
+    return Capture_mulQ8(ticks, CAPTURE_TICK_NS_Q8);
+}
+
+UINT16 Capture_dutyPermille(UINT32 high, UINT32 low) {
+    /* high * 1000 / (high + low), both scaled down together until
+     * the multiply fits in 32 bits
+     */
+    while (high > 0xFFFFFFFFUL / 1000 || low > 0x7FFFFFFFUL - high) {
+        high >>= 1;
+        low >>= 1;
+    }
+    if (high + low == 0) {
+        return 0;
+    }
+    return high * 1000 / (high + low);
+}
+
+UINT32 Capture_freqMilliHz(UINT32 count) {
+    /* freq_mHz = CAPTURE_FREQ_NUM * 1000 / count
+     * The numerator does not fit in 32 bits, so the integer Hz come from
+     * one division and the 3 decimal digits from the remainder.
+     */
+    UINT32 hz, rem, frac;
+
+    if (count == 0) {
+        return 0;
+    }
+    hz = CAPTURE_FREQ_NUM / count;
+    rem = CAPTURE_FREQ_NUM % count;
+    if (hz > 0xFFFFFFFFUL / 1000 - 1) {
+        return 0xFFFFFFFFUL; // Above ~4.29MHz
+    }
+
+    if (count <= 0xFFFFFFFFUL / 1000) {
+        frac = rem * 1000 / count;
+    } else {
+        // Very long periods (< 1/1000 of the full-scale frequency)
+        frac = rem / (count / 1000);
+        if (frac > 999) {
+            frac = 999;
+        }
+    }
+    return hz * 1000 + frac;
+}
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef CAPTURE_STATS_H
+#define CAPTURE_STATS_H
+
+#include <GenericTypeDefs.h>
+
+/* Streaming statistics over a window of capture counts
+ *
+ * Stats_add() is called from the capture ISR with every new count. It keeps
+ * min, max, a shifted sum and sum of squares, and optionally a coarse
+ * histogram, with no division. After `window` samples the accumulators are
+ * handed over to the main loop, which works out mean and standard deviation
+ * in Stats_read().
+ *
+ * Shifted sums:
+ *   d = x - ref, where ref is the first sample of the window
+ *   mean     = ref + sum(d) / n
+ *   variance = sum(d^2) / n - (sum(d) / n)^2
+ *   Using d instead of x keeps the numbers small for a steady input, so the
+ *   variance of a 32-bit count is exact. |d| is limited to 65535 (a spread of
+ *   65535 counts) and sum(d^2) is kept in 64 bits as two UINT32.
+ *
+ * Histogram, only when STATS_BINS is defined:
+ *   STATS_BINS bins of 2^hist_shift counts each, starting at hist_min.
+ *   Counts below or above the range go into the first or last bin.
+ *   Stats_histRange() sets the range from the counts expected, e.g. the
+ *   min and max of the last window. PIC18 has no barrel shifter, so the
+ *   variable shift that picks the bin is a loop of hist_shift steps (up to
+ *   31 for a 32-bit count): the update is bounded, not the same each time.
+ *   Without STATS_BINS the update has no loop.
+ *
+ * Two banks are used: the ISR fills one while main reads the other. If main
+ * has not read the last window when the next one completes, the new window is
+ * dropped (its bank is cleared) and counted in stats_overrun.
+ */
+
+typedef struct {
+    UINT8 n;
+    UINT32 ref;
+    INT32 sum;
+    UINT32 sumsq_lo;
+    UINT32 sumsq_hi;
+    UINT32 min;
+    UINT32 max;
+#ifdef STATS_BINS
+    UINT16 hist[STATS_BINS];
+#endif
+} StatsBank;
+
+typedef struct {
+    UINT8 n;
+    UINT32 min;
+    UINT32 max;
+    UINT32 mean;
+    UINT32 stddev;
+#ifdef STATS_BINS
+    UINT16 hist[STATS_BINS];
+#endif
+} CaptureStats;
+
+StatsBank stats_bank[2];
+volatile UINT8 stats_fill = 0; // Bank being filled by the ISR
+volatile BOOL stats_ready = FALSE; // Other bank holds a finished window
+UINT8 stats_window = 16;
+#ifdef STATS_BINS
+UINT32 stats_hist_min = 0;
+UINT8 stats_hist_shift = 0;
+#endif
+volatile UINT16 stats_overrun = 0;
+
+// Function prototype
+void Stats_setup(UINT8 window);
+#ifdef STATS_BINS
+void Stats_histRange(UINT32 min, UINT32 max);
+#endif
+void Stats_clear(StatsBank *b);
+void Stats_add(UINT32 x);
+BOOL Stats_read(CaptureStats *out);
+UINT32 Stats_sqrt(UINT32 x);
+UINT32 Stats_div64(UINT32 hi, UINT32 lo, UINT8 n);
+
+
+void Stats_clear(StatsBank *b) {
+#ifdef STATS_BINS
+    UINT8 i;
+    for (i = 0; i < STATS_BINS; i++) {
+        b->hist[i] = 0;
+    }
+#endif
+    b->n = 0;
+    b->sum = 0;
+    b->sumsq_lo = 0;
+    b->sumsq_hi = 0;
+}
+
+#ifdef STATS_BINS
+void Stats_histRange(UINT32 min, UINT32 max) {
+    /* Smallest power of 2 bin width that spreads min..max over the bins.
+     * From main, the ISR may see the old min with the new shift for one
+     * count, which only puts that count in a wrong bin.
+     */
+    UINT8 shift = 0;
+    UINT32 span = max > min ? max - min : 0;
+    while (shift < 31 && (span >> shift) >= STATS_BINS) {
+        shift++;
+    }
+    stats_hist_min = min;
+    stats_hist_shift = shift;
+}
+#endif
+
+void Stats_setup(UINT8 window) {
+    /* window: samples per result (1-255) */
+    stats_window = window ? window : 1;
+#ifdef STATS_BINS
+    stats_hist_min = 0;
+    stats_hist_shift = 31; // Everything in the first bin until a range is set
+#endif
+    Stats_clear(&stats_bank[0]);
+    Stats_clear(&stats_bank[1]);
+    stats_fill = 0;
+    stats_ready = FALSE;
+}
+
+void Stats_add(UINT32 x) {
+    /* Called from the ISR */
+    StatsBank *b = &stats_bank[stats_fill];
+    INT32 d;
+    UINT32 sq;
+#ifdef STATS_BINS
+    UINT32 bin;
+#endif
+
+    if (b->n == 0) {
+        b->ref = x;
+        b->min = x;
+        b->max = x;
+    }
+    if (x < b->min) {
+        b->min = x;
+    }
+    if (x > b->max) {
+        b->max = x;
+    }
+
+    d = (INT32) (x - b->ref);
+    if (d > 65535) {
+        d = 65535;
+    } else if (d < -65535) {
+        d = -65535;
+    }
+    b->sum += d;
+    sq = (UINT32) (d < 0 ? -d : d);
+    sq = sq * sq;
+    b->sumsq_lo += sq;
+    if (b->sumsq_lo < sq) {
+        b->sumsq_hi++; // Carry
+    }
+
+#ifdef STATS_BINS
+    if (x <= stats_hist_min) {
+        bin = 0;
+    } else {
+        bin = (x - stats_hist_min) >> stats_hist_shift;
+        if (bin >= STATS_BINS) {
+            bin = STATS_BINS - 1;
+        }
+    }
+    b->hist[bin]++;
+#endif
+
+    if (++b->n >= stats_window) {
+        if (!stats_ready) {
+            stats_fill ^= 1; // Other bank was cleared by Stats_read()
+            stats_ready = TRUE;
+        } else {
+            stats_overrun++;
+            Stats_clear(b);
+        }
+    }
+}
+
+UINT32 Stats_div64(UINT32 hi, UINT32 lo, UINT8 n) {
+    /* (hi:lo) / n in 16-bit steps, result must fit in 32 bits */
+    UINT32 rem = hi % n;
+    UINT32 part;
+    part = (rem << 16) | (lo >> 16);
+    rem = part % n;
+    part = part / n;
+    return (part << 16) | (((rem << 16) | (lo & 0xFFFF)) / n);
+}
+
+UINT32 Stats_sqrt(UINT32 x) {
+    /* Integer square root, bit by bit (16 iterations) */
+    UINT32 root = 0;
+    UINT32 bit = 0x40000000UL;
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+BOOL Stats_read(CaptureStats *out) {
+    /* TRUE and fills out when a new window has finished */
+    StatsBank *b;
+    INT32 mean_d;
+    UINT32 mean_sq, ex2;
+#ifdef STATS_BINS
+    UINT8 i;
+#endif
+
+    if (!stats_ready) {
+        return FALSE;
+    }
+    b = &stats_bank[stats_fill ^ 1];
+
+    out->n = b->n;
+    out->min = b->min;
+    out->max = b->max;
+#ifdef STATS_BINS
+    for (i = 0; i < STATS_BINS; i++) {
+        out->hist[i] = b->hist[i];
+    }
+#endif
+
+    // mean = ref + sum / n, rounded
+    if (b->sum >= 0) {
+        mean_d = (b->sum + b->n / 2) / b->n;
+    } else {
+        mean_d = -((-b->sum + b->n / 2) / b->n);
+    }
+    out->mean = b->ref + mean_d;
+
+    // variance = E[d^2] - E[d]^2
+    ex2 = Stats_div64(b->sumsq_hi, b->sumsq_lo, b->n);
+    mean_sq = (UINT32) (mean_d < 0 ? -mean_d : mean_d);
+    mean_sq = mean_sq * mean_sq;
+    out->stddev = (ex2 > mean_sq) ? Stats_sqrt(ex2 - mean_sq) : 0;
+
+    Stats_clear(b);
+    stats_ready = FALSE; // Hand the bank back to the ISR
+    return TRUE;
+}
+
+#endif
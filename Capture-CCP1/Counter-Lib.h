@@ -0,0 +1,219 @@
+#ifndef COUNTER_LIB_H
+#define COUNTER_LIB_H
+
+#include <GenericTypeDefs.h>
+
+/* Gate-time frequency counter on Timer0 (T0CKI), switched with CCP1 capture
+ *
+ * The input clocks Timer0 through RA4/T0CKI. Timer0 overflows are counted in
+ * software, so the edge count is 32 bits. The gate comes from CCP2 in compare
+ * mode on Timer1 (the same free-running, 32-bit Timer1 as Capture-Lib.h): a
+ * compare matches once per Timer1 wrap, and the one whose upper word matches
+ * the gate end is the end of the gate. The next gate end is the old one plus
+ * COUNTER_GATE_MS, so gates follow each other with no gap or drift.
+ *
+ * Timer0 is read by Counter_latch(), which must be the first thing the ISR
+ * does, before the capture handler, so the count is taken a fixed time
+ * after the match. What is left is the ISR entry latency: when the match
+ * comes while the ISR is already running (e.g. in Capture_isr()), Timer0 is
+ * read only after the rest of that run, and the gate is that much longer
+ * or shorter. The error is frequency * delay edges, e.g. 20Tcy (8us at
+ * 10MHz) at 100kHz is 0.8 of an edge in a 10000 edge gate.
+ *
+ *   frequency = edges * Timer0 prescale * 1000 / COUNTER_GATE_MS
+ *
+ * Resolution is 1 edge per gate (10Hz at 100ms, x8 with the prescaler), so
+ * gate counting is used for high frequencies and reciprocal capture for low
+ * ones. The gate runs all the time, and at every gate end:
+ *   - above COUNTER_GATE_HZ, CCP1 capture is turned off and the gate count
+ *     is the reading (no interrupt per edge)
+ *   - below COUNTER_CAPTURE_HZ, CCP1 capture is turned back on (auto-ranging,
+ *     every 16th edge first)
+ * COUNTER_GATE_HZ defaults to the rate at which every 16th edge hits
+ * CAPTURE_MAX_IRQ_HZ, the fastest input capture can follow.
+ *
+ * Timer0 prescaler:
+ *   Without it, T0CKI high and low times must be at least 0.5 Tcy + 20ns
+ *   (about 2MHz at 10MHz FOSC). Above COUNTER_PS_HZ the 1:8 prescaler is
+ *   used instead, good for ~18MHz. A prescaler change or a Timer1 prescaler
+ *   change (capture auto-ranging) throws away the gate in progress.
+ *
+ * Wiring: the signal goes to RC2 (CCP1) and RA4 (T0CKI), each through its
+ * own 10k resistor. RA4 is also switch S2 on the board, do not press it.
+ *
+ * Capture-Lib.h must be included and Capture_setupAutoRange() called first.
+ */
+
+#ifndef CAPTURE_LIB_H
+#error "Capture-Lib.h must be included before Counter-Lib.h"
+#endif
+#ifndef COUNTER_GATE_MS
+#define COUNTER_GATE_MS (100) // Must divide 1000
+#endif
+#ifndef COUNTER_GATE_HZ
+#define COUNTER_GATE_HZ ((UINT32) CAPTURE_MAX_IRQ_HZ * 16)
+#endif
+#ifndef COUNTER_CAPTURE_HZ
+#define COUNTER_CAPTURE_HZ (COUNTER_GATE_HZ / 2)
+#endif
+#ifndef COUNTER_PS_HZ
+#define COUNTER_PS_HZ (FOSC / 4 / 2) // 1.25MHz at 10MHz
+#endif
+#define COUNTER_GATE_TCY ((UINT32) FOSC / 4 / 1000 * COUNTER_GATE_MS)
+
+volatile UINT16 counter_t0_high = 0; // Timer0 bits 16:31
+UINT32 counter_t0_last = 0;
+UINT32 counter_t0_latch = 0; // Timer0 at ISR entry on CCP2IF
+BOOL counter_latched = FALSE;
+UINT32 counter_gate_end = 0; // Timer1 time of the next gate end
+UINT8 counter_gate_t1ckps = 0; // Timer1 prescaler the gate was started with
+BOOL counter_skip = TRUE; // Next gate end only restarts the count
+UINT8 counter_t0_shift = 0; // log2 Timer0 prescale
+Snap32 counter_hz = { 0, 0 }; // Last gate result
+UINT8 counter_seen = 0; // counter_hz.seq at the last Counter_read()
+volatile BOOL counter_gate_mode = FALSE; // TRUE while capture is off
+
+// Function prototype
+void Counter_setup(void);
+UINT32 Counter_readT0(void);
+void Counter_latch(void);
+void Counter_startGate(void);
+void Counter_checkMode(UINT32 hz);
+void Counter_isr(void);
+BOOL Counter_read(UINT32 *hz);
+
+
+void Counter_setup(void) {
+    TRISAbits.TRISA4 = 1; // RA4/T0CKI as input
+
+    /* Timer0, 16-bit counter on T0CKI */
+    T0CONbits.TMR0ON = 0;
+    T0CONbits.T08BIT = 0; // 0 = 16-bit timer/counter
+    T0CONbits.T0CS = 1; // 1 = Transition on T0CKI pin
+    T0CONbits.T0SE = 0; // 0 = Increment on low-to-high transition
+    T0CONbits.PSA = 1; // 1 = Timer0 prescaler is not assigned
+    T0CONbits.T0PS = 0b010; // 1:8 when the prescaler is assigned
+    counter_t0_shift = 0;
+    TMR0H = 0;
+    TMR0L = 0;
+    INTCONbits.TMR0IF = 0;
+    INTCONbits.TMR0IE = 1; // Enable Timer0 overflow interrupt
+
+    /* CCP2 compare on Timer1 (T3CCP2:T3CCP1 = 00 from Capture_setup) */
+    CCP2CONbits.CCP2M = 0b1010; // Compare mode, software interrupt only
+    Counter_startGate();
+    PIR2bits.CCP2IF = 0;
+    PIE2bits.CCP2IE = 1; // Enable CCP2 interrupt
+
+    T0CONbits.TMR0ON = 1; // 1 = Enables Timer0
+}
+
+UINT32 Counter_readT0(void) {
+    /* 32-bit Timer0 count, from the ISR. Reading TMR0L latches TMR0H.
+     * A pending overflow with the count in its lower half has happened
+     * but is not in counter_t0_high yet.
+     */
+    UINT16 low, high;
+    low = TMR0L;
+    low |= (UINT16) TMR0H << 8;
+    high = counter_t0_high;
+    if (INTCONbits.TMR0IF && !(low & 0x8000)) {
+        high++;
+    }
+    return ((UINT32) high << 16) | low;
+}
+
+void Counter_latch(void) {
+    /* First thing in the ISR: Timer0 as close to the CCP2 match as it gets */
+    if (PIR2bits.CCP2IF) {
+        counter_t0_latch = Counter_readT0();
+        counter_latched = TRUE;
+    }
+}
+
+void Counter_startGate(void) {
+    /* Next gate end one gate time from now, in Timer1 ticks */
+    UINT16 low, high;
+    low = TMR1L;
+    low |= (UINT16) TMR1H << 8;
+    high = capture_t1_high;
+    if (PIR1bits.TMR1IF && !(low & 0x8000)) {
+        high++;
+    }
+    counter_gate_t1ckps = T1CONbits.T1CKPS;
+    counter_gate_end = (((UINT32) high << 16) | low) + (COUNTER_GATE_TCY >> CAPTURE_RANGE_T1SHIFT[capture_range]);
+    CCPR2 = (UINT16) counter_gate_end;
+    counter_skip = TRUE;
+}
+
+void Counter_checkMode(UINT32 hz) {
+    /* Called from the ISR at every gate end */
+    if (!counter_gate_mode && hz > COUNTER_GATE_HZ) {
+        // Too many capture interrupts: count edges only
+        counter_gate_mode = TRUE;
+        capture_autorange = FALSE; // Timeouts must not turn CCP1 back on
+        CCP1CON = 0; // 0000 = Capture/Compare/PWM off, no more CCP1IF
+        PIR1bits.CCP1IF = 0;
+        Snap32_write(&capture_count, 0);
+        capture_started = FALSE;
+    } else if (counter_gate_mode && hz < COUNTER_CAPTURE_HZ) {
+        // Slow enough to capture, with far better resolution
+        counter_gate_mode = FALSE;
+        capture_autorange = TRUE;
+        Capture_setRange(CAPTURE_RANGES - 1);
+    }
+
+    if (counter_t0_shift == 0 && hz > COUNTER_PS_HZ) {
+        T0CONbits.PSA = 0; // 0 = Timer0 prescaler is assigned (1:8)
+        counter_t0_shift = 3;
+        counter_skip = TRUE;
+    } else if (counter_t0_shift != 0 && hz < COUNTER_PS_HZ / 2) {
+        T0CONbits.PSA = 1;
+        counter_t0_shift = 0;
+        counter_skip = TRUE;
+    }
+}
+
+void Counter_isr(void) {
+    /* Call from the ISR when CCP2IF or TMR0IF is set, after Counter_latch().
+     * A CCP2IF set since then waits for the next ISR run, which latches it.
+     */
+    if (PIR2bits.CCP2IF && counter_latched) {
+        UINT16 high = capture_t1_high;
+        PIR2bits.CCP2IF = 0; //clear interrupt flag
+        counter_latched = FALSE;
+        if (PIR1bits.TMR1IF && !(CCPR2 & 0x8000)) {
+            high++; // Timer1 overflow not counted yet
+        }
+
+        if (T1CONbits.T1CKPS != counter_gate_t1ckps) {
+            Counter_startGate(); // Gate time changed under us
+        } else if (high == (UINT16) (counter_gate_end >> 16)) {
+            UINT32 t0 = counter_t0_latch;
+
+            if (counter_skip) {
+                counter_skip = FALSE; // Start of the first full gate
+            } else {
+                UINT32 hz = ((t0 - counter_t0_last) << counter_t0_shift) * (1000 / COUNTER_GATE_MS);
+                Snap32_write(&counter_hz, hz);
+                Counter_checkMode(hz);
+            }
+            counter_t0_last = t0;
+
+            counter_gate_end += COUNTER_GATE_TCY >> CAPTURE_RANGE_T1SHIFT[capture_range];
+            CCPR2 = (UINT16) counter_gate_end;
+        }
+    }
+
+    if (INTCONbits.TMR0IF) {
+        INTCONbits.TMR0IF = 0; //clear interrupt flag
+        counter_t0_high++;
+    }
+}
+
+BOOL Counter_read(UINT32 *hz) {
+    /* Frequency from the last gate, TRUE when it is new */
+    return Snap32_readNew(&counter_hz, hz, &counter_seen);
+}
+
+#endif
@@ -0,0 +1,262 @@
+#ifndef PROF_LIB_H
+#define PROF_LIB_H
+
+#include <GenericTypeDefs.h>
+#include <stdio.h>
+
+/* ISR latency, duration and CPU load
+ *
+ * Opt in by defining PROF_ENABLE before including this file. Without it the
+ * macros are empty and the ISRs are exactly as before.
+ *   PROF_ENTER(src)        first line of the code for a source in the ISR
+ *   PROF_LATENCY(src, tcy) Tcy from the event to PROF_ENTER, read from the
+ *                          source's own timer (TMR2 since the match, TMR1 -
+ *                          CCPR1 since the capture, ...)
+ *   PROF_EXIT(src)         last line of the code for that source
+ * src is 0 to PROF_SOURCES - 1, one per interrupt source, chosen by the
+ * project. Prof_read() gives the average and worst latency and duration of
+ * a source in us, Prof_load() the share of time spent between ENTER and
+ * EXIT of all sources, and Prof_report() formats both as two 16 character
+ * lines for the LCD or a UART.
+ *
+ * Time comes from a free-running timer at Tcy / PROF_PRESCALE (1, 2, 4, 8):
+ *   default      Timer3
+ *   PROF_TIMER0  Timer0, when Timer3 is taken (e.g. the A/D trigger)
+ * Its overflow flag is polled, not used as an interrupt, and a read tells
+ * whether a set flag is already in the count from the timer's top bit. That
+ * only works while reads are less than half a wrap apart, so there must be
+ * a PROF_ENTER, PROF_EXIT or Prof_load() at least every 32768 *
+ * PROF_PRESCALE Tcy, or the elapsed time comes out wrong.
+ *
+ * The context save before the first line of the ISR and the restore after
+ * the last are outside ENTER/EXIT, so the load is a little low.
+ *
+ * Debug pins: define PROF_PINS as a LAT register (e.g. LATB) and each
+ * source drives the bit PROF_PIN(src) (default 1 << src) high from ENTER
+ * to EXIT, for a scope. Its TRIS bit is up to the project.
+ *
+ * FOSC (in Hz, as an integer) must be defined before including this file.
+ */
+
+#ifndef FOSC
+#error "FOSC must be defined before including Prof-Lib.h"
+#endif
+#ifndef PROF_SOURCES
+#define PROF_SOURCES (4)
+#endif
+#ifndef PROF_PRESCALE
+#define PROF_PRESCALE (1)
+#endif
+#if PROF_PRESCALE == 1
+#define PROF_CKPS (0)
+#elif PROF_PRESCALE == 2
+#define PROF_CKPS (1)
+#elif PROF_PRESCALE == 4
+#define PROF_CKPS (2)
+#elif PROF_PRESCALE == 8
+#define PROF_CKPS (3)
+#else
+#error "PROF_PRESCALE must be 1, 2, 4 or 8"
+#endif
+#ifndef PROF_PIN
+#define PROF_PIN(src) (1 << (src))
+#endif
+
+#ifdef PROF_ENABLE
+#ifdef PROF_PINS
+#define PROF_ENTER(src)        { PROF_PINS |= PROF_PIN(src); Prof_enter(src); }
+#define PROF_EXIT(src)         { Prof_exit(src); PROF_PINS &= ~PROF_PIN(src); }
+#else
+#define PROF_ENTER(src)        Prof_enter(src);
+#define PROF_EXIT(src)         Prof_exit(src);
+#endif
+#define PROF_LATENCY(src, tcy) Prof_latency(src, tcy);
+#else
+#define PROF_ENTER(src)
+#define PROF_EXIT(src)
+#define PROF_LATENCY(src, tcy)
+#endif
+
+typedef struct {
+    UINT16 n; // Handler runs
+    UINT16 lat_n; // Latency samples
+    UINT32 lat_sum; // Tcy
+    UINT16 lat_max;
+    UINT32 dur_sum; // Timer ticks
+    UINT16 dur_max;
+} ProfSource;
+
+typedef struct {
+    UINT16 n;
+    UINT16 lat_avg_us;
+    UINT16 lat_max_us;
+    UINT16 dur_avg_us;
+    UINT16 dur_max_us;
+} ProfStats;
+
+ProfSource prof_src[PROF_SOURCES];
+UINT16 prof_high = 0; // Timer extension, in 65536 tick wraps
+UINT16 prof_entry = 0; // Timer at the last PROF_ENTER
+UINT32 prof_busy = 0; // Ticks between ENTER and EXIT
+UINT32 prof_start = 0;
+
+// Function prototype
+void Prof_setup(void);
+void Prof_clear(void);
+UINT32 Prof_now(void);
+void Prof_enter(UINT8 src);
+void Prof_latency(UINT8 src, UINT16 tcy);
+void Prof_exit(UINT8 src);
+void Prof_read(UINT8 src, ProfStats *s);
+UINT16 Prof_load(void);
+UINT16 Prof_toUs(UINT32 tcy);
+void Prof_report(UINT8 src, char *line1, char *line2);
+
+
+void Prof_setup(void) {
+#ifdef PROF_TIMER0
+    T0CONbits.TMR0ON = 0;
+    T0CONbits.T08BIT = 0; // 0 = 16-bit timer/counter
+    T0CONbits.T0CS = 0; // 0 = Internal instruction cycle clock
+    T0CONbits.PSA = (PROF_PRESCALE == 1); // 1 = Timer0 prescaler is not assigned
+    T0CONbits.T0PS = (PROF_CKPS - 1) & 0b111; // 000 = 1:2, 001 = 1:4, 010 = 1:8
+    TMR0H = 0;
+    TMR0L = 0;
+    INTCONbits.TMR0IF = 0;
+    T0CONbits.TMR0ON = 1;
+#else
+    T3CONbits.TMR3ON = 0;
+    T3CONbits.RD16 = 1; // 16-bit read/write
+    T3CONbits.TMR3CS = 0; // Internal clock (FOSC/4)
+    T3CONbits.T3CKPS = PROF_CKPS;
+    TMR3H = 0;
+    TMR3L = 0;
+    PIR2bits.TMR3IF = 0;
+    T3CONbits.TMR3ON = 1;
+#endif
+    Prof_clear();
+}
+
+void Prof_clear(void) {
+    UINT8 i;
+    UINT8 gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    for (i = 0; i < PROF_SOURCES; i++) {
+        prof_src[i].n = 0;
+        prof_src[i].lat_n = 0;
+        prof_src[i].lat_sum = 0;
+        prof_src[i].lat_max = 0;
+        prof_src[i].dur_sum = 0;
+        prof_src[i].dur_max = 0;
+    }
+    prof_busy = 0;
+    prof_start = Prof_now();
+    INTCONbits.GIEH = gie;
+}
+
+UINT32 Prof_now(void) {
+    /* Ticks, call from the ISR or with GIEH = 0 */
+    UINT16 t;
+#ifdef PROF_TIMER0
+    t = TMR0L; // Latches TMR0H
+    t |= (UINT16) TMR0H << 8;
+    if (INTCONbits.TMR0IF && !(t & 0x8000)) {
+        INTCONbits.TMR0IF = 0; // Wrapped before this read
+        prof_high++;
+    }
+#else
+    t = TMR3L; // Latches TMR3H
+    t |= (UINT16) TMR3H << 8;
+    if (PIR2bits.TMR3IF && !(t & 0x8000)) {
+        PIR2bits.TMR3IF = 0; // Wrapped before this read
+        prof_high++;
+    }
+#endif
+    return ((UINT32) prof_high << 16) | t;
+}
+
+void Prof_enter(UINT8 src) {
+    prof_entry = (UINT16) Prof_now();
+    prof_src[src].n++;
+}
+
+void Prof_latency(UINT8 src, UINT16 tcy) {
+    ProfSource *p = &prof_src[src];
+    p->lat_n++;
+    p->lat_sum += tcy;
+    if (tcy > p->lat_max) {
+        p->lat_max = tcy;
+    }
+}
+
+void Prof_exit(UINT8 src) {
+    ProfSource *p = &prof_src[src];
+    UINT16 d = (UINT16) Prof_now() - prof_entry;
+    p->dur_sum += d;
+    if (d > p->dur_max) {
+        p->dur_max = d;
+    }
+    prof_busy += d;
+}
+
+UINT16 Prof_toUs(UINT32 tcy) {
+    return tcy * 400 / (FOSC / 10000);
+}
+
+void Prof_read(UINT8 src, ProfStats *s) {
+    ProfSource p;
+    UINT8 gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    p = prof_src[src];
+    INTCONbits.GIEH = gie;
+
+    s->n = p.n;
+    s->lat_avg_us = p.lat_n ? Prof_toUs(p.lat_sum / p.lat_n) : 0;
+    s->lat_max_us = Prof_toUs(p.lat_max);
+    s->dur_avg_us = p.n ? Prof_toUs(p.dur_sum / p.n * PROF_PRESCALE) : 0;
+    s->dur_max_us = Prof_toUs((UINT32) p.dur_max * PROF_PRESCALE);
+}
+
+UINT16 Prof_load(void) {
+    /* Permille of the time since Prof_clear() spent in the handlers */
+    UINT32 total, busy;
+    UINT8 gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    total = Prof_now() - prof_start;
+    busy = prof_busy;
+    INTCONbits.GIEH = gie;
+
+    // Scale down so busy * 1000 fits in 32 bits
+    while (total > 0x3FFFFFUL) {
+        total >>= 1;
+        busy >>= 1;
+    }
+    return total ? (UINT16) (busy * 1000 / total) : 0;
+}
+
+void Prof_report(UINT8 src, char *line1, char *line2) {
+    /* Two lines of 16 characters, padded, for the LCD:
+     *   "3 cpu 12.5%     "  source, total load
+     *   "L4/9 D35/60     "  latency and duration, average/worst in us
+     * line1 and line2 need room for 28 characters, sprintf writes whole
+     * numbers before the line is cut at 16.
+     */
+    ProfStats s;
+    UINT16 load = Prof_load();
+    int len;
+
+    Prof_read(src, &s);
+    len = sprintf(line1, "%u cpu %u.%u%%", src, load / 10, load % 10);
+    while (len < 16) {
+        line1[len++] = ' ';
+    }
+    line1[16] = 0;
+    len = sprintf(line2, "L%u/%u D%u/%u", s.lat_avg_us, s.lat_max_us,
+                  s.dur_avg_us, s.dur_max_us);
+    while (len < 16) {
+        line2[len++] = ' ';
+    }
+    line2[16] = 0;
+}
+
+#endif
@@ -16,6 +16,8 @@
 #include <p18f4520.h>
 #include <GenericTypeDefs.h>
 #include <delays.h>
+
+#define FOSC (10000000UL) // 10MHz HS mode
 #include "LCD-Lib.h"
 
 const UINT8 arrow[] = {
@@ -34,11 +36,12 @@ void createChar(UINT8 address, UINT8 line, UINT8 data);
 
 void main(void) {
     UINT8 i;
+    DelayTime last;
     
     LCD_TRIS = 0;
     LCD_LAT_Vcc = 1; // Turn on LCD on the board
     
-    Delay1KTCYx(100); // Delay before initialising display
+    delay_ms(40); // Delay before initialising display
     LCD_setup();
     
     LCD_clearDisplay();
@@ -49,13 +52,19 @@ void main(void) {
         createChar(0, i, arrow[i]);
     }
     
+    // Redraw every 400ms on Timer0, without blocking
+    Delay_setupTimer();
+    last = Delay_now() - DELAY_MS_TICKS(400); // Draw straight away
+    
     while (1) {
         char text1[] = " Custom Chars ";
-        LCD_clearDisplay();
-        LCD_writeChar(0x00); // Print arrow at CGRAM address 0x00
-        LCD_puts(text1);
-        LCD_writeChar(0x08); // Print same arrow (bit 3 has no effect)
-        Delay10KTCYx(100);
+        if (elapsed(last, 400)) {
+            last += DELAY_MS_TICKS(400);
+            LCD_clearDisplay();
+            LCD_writeChar(0x00); // Print arrow at CGRAM address 0x00
+            LCD_puts(text1);
+            LCD_writeChar(0x08); // Print same arrow (bit 3 has no effect)
+        }
     }
 }
 
@@ -1,3 +1,4 @@
+#include "Delay-Lib.h"
 // Define pin connections
 #define LCD_TRIS (TRISD)
 #define LCD_LAT_Vcc (LATDbits.LATD7) 
@@ -16,8 +17,9 @@ void LCD_shiftAddress(BOOL shift, BOOL left);
 void LCD_returnHome();
 void LCD_clearDisplay();
 
-// Define LCD delay
-#define LCD_delay() Delay10TCYx(100)
+// Define LCD delay, per step: six steps a byte also cover the 1.52ms clear
+#define LCD_DELAY_US (400)
+#define LCD_delay() delay_us(LCD_DELAY_US)
 
 
 void LCD_setup() {
@@ -9,12 +9,27 @@
  *     RD5     -> RW (0 = Write, 1 = Read)
  *     RD6     -> En (Start data read-write)
  *     RD7     -> Vcc
+ *
+ * The power-up wait and the scrolling are soft timers of the
+ * scheduler (Sched-Lib.h) on a 1ms Timer 2 tick, so main never
+ * spins in a delay between frames.
  */
 
 #include <p18f4520.h>
 #include <GenericTypeDefs.h>
 #include <delays.h>
 
+#define FOSC (10000000UL) // 10MHz HS mode
+#include "Sched-Lib.h"
+#include "Delay-Lib.h"
+
+// Tasks, in priority order
+#define TASK_LCD_INIT (0)
+#define TASK_SCROLL   (1)
+
+// Soft timers
+#define TIMER_LCD     (0)
+
 // Define pin connections
 #define LCD_TRIS (TRISD)
 #define LCD_LAT_Vcc (LATDbits.LATD7) 
@@ -32,9 +47,13 @@ void LCD_setCursor(UINT8 line, INT8 position);
 void LCD_shiftAddress(BOOL shift, BOOL left);
 void LCD_returnHome();
 void LCD_clearDisplay();
+void lcd_init_task(void);
+void scroll_task(void);
+void InterruptHandlerHigh(void);
 
-// Define LCD delay
-#define LCD_delay() Delay10TCYx(100)
+// Define LCD delay, per step: six steps a byte also cover the 1.52ms clear
+#define LCD_DELAY_US (400)
+#define LCD_delay() delay_us(LCD_DELAY_US)
 
 
 void LCD_setup() {
@@ -132,35 +151,75 @@ void LCD_puts(char * txt) {
     }
 }
 
+void lcd_init_task(void) {
+    LCD_setup();
+    
+    LCD_clearDisplay();
+    LCD_returnHome();
+    
+    Sched_startTimer(TIMER_LCD, TASK_SCROLL, 1, 120); // New frame every 120ms
+}
+
+void scroll_task(void) {
+    static UINT8 i = 0;
+    char text1[] = "Hello :)", text2[] = ":P World";
+    
+    LCD_clearDisplay();
+    
+    // Shift 1st line to right
+    LCD_setCursor(0, i);
+    LCD_puts(text1);
+
+    // Shift 2nd line to left
+    LCD_setCursor(1, 16 - i);
+    LCD_puts(text2);
+    
+    if (++i >= 25) {
+        i = 0;
+    }
+}
+
 void main(void) {
     LCD_TRIS = 0; // Set LCD port as output
     LCD_LAT_Vcc = 1; // Turn on LCD on the board
     
-    Delay1KTCYx(100); // Delay before initialising display
-    LCD_setup();
+    Sched_init();
+    Sched_addTask(TASK_LCD_INIT, lcd_init_task);
+    Sched_addTask(TASK_SCROLL, scroll_task);
+    Sched_startTimer(TIMER_LCD, TASK_LCD_INIT, 40, 0); // Wait before initialising display
     
-    LCD_clearDisplay();
-    LCD_returnHome();
+    Sched_setupTimer2();
+    INTCONbits.GIEH = 1;
+    
+    Sched_run(); // Never returns
+}
 
-    while (1) {
-        char text1[] = "Hello :)", text2[] = ":P World";
-        UINT8 i = 0;
-        for (i = 0; i < 25; i++) {
-            LCD_clearDisplay();
-            
-            // Shift 1st line to right
-            LCD_setCursor(0, i);
-            LCD_puts(text1);
-
-            // Shift 2nd line to left
-            LCD_setCursor(1, 16 - i);
-            LCD_puts(text2);
-            
-            Delay10KTCYx(30);
-        }
+
+//----------------------------------------------------------------------------
+// High priority interrupt vector
+
+#pragma code InterruptVectorHigh = 0x08
+void InterruptVectorHigh(void) {
+    _asm
+    goto InterruptHandlerHigh //jump to interrupt routine
+    _endasm
+}
+
+//----------------------------------------------------------------------------
+// High priority interrupt routine
+
+#pragma code
+#pragma interrupt InterruptHandlerHigh save=section(".tmpdata")
+
+void InterruptHandlerHigh(void) {
+    if (PIR1bits.TMR2IF) {
+        PIR1bits.TMR2IF = 0; //clear interrupt flag
+        Sched_tick();
     }
 }
 
+//----------------------------------------------------------------------------
+
 
 
 
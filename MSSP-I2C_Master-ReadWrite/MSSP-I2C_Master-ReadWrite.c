@@ -20,6 +20,9 @@
 #include <delays.h>
 #include "MCP_Addresses.h"
 
+#define FOSC (10000000UL) // 10MHz HS mode
+#include "Delay-Lib.h"
+
 #define HIGH_SPEED_I2C
 
 /**
@@ -121,6 +124,8 @@ UINT8 MCP23017_read(char reg) {
 }
 
 void main(void) {
+    DelayTime last;
+
     /* Set input for I2C pins */
     TRISCbits.TRISC3 = 1; // Serial clock (SCL) - RC3/SCK/SCL
     TRISCbits.TRISC4 = 1; // Serial data (SDA) - RC4/SDI/SDA
@@ -161,16 +166,21 @@ void main(void) {
     
     /* Send value on startup for debugging */
     MCP23008_write(MCP23008_GPIO, 0xAA);
-    Delay10KTCYx(100);
+    Delay_setupTimer();
+    last = Delay_now(); // Leave it on for the first 400ms
 
     while(1) {
         UINT8 result;
 
+        if (!elapsed(last, 400)) {
+            continue; // Free for other work
+        }
+        last += DELAY_MS_TICKS(400);
+
         /* Read value from MCP23017 GPIOA and output it on MCP23008 */
         result = MCP23017_read(MCP23017_GPIOA);
         MCP23008_write(MCP23008_GPIO, result);
         
         LATB ^= 0x01; // blink LED for debugging
-        Delay10KTCYx(100);
     }
 }
\ No newline at end of file
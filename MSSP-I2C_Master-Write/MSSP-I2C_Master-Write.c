@@ -15,6 +15,9 @@
 #include <GenericTypeDefs.h>
 #include <delays.h>
 
+#define FOSC (10000000UL) // 10MHz HS mode
+#include "Delay-Lib.h"
+
 #define HIGH_SPEED_I2C
 
 /* Seven Segment Active-Low Hex Values */
@@ -85,6 +88,9 @@ void MCP23008_write(char reg, char val) {
 }
 
 void main(void) {
+    DelayTime last;
+    INT8 i;
+
     /* Set input for I2C pins */
     TRISCbits.TRISC3 = 1; // Serial clock (SCL) - RC3/SCK/SCL
     TRISCbits.TRISC4 = 1; // Serial data (SDA) - RC4/SDI/SDA
@@ -122,17 +128,22 @@ void main(void) {
     MCP23008_write(0x00, 0x00);
     
     /* Display Hex digits (0-F) on the seven segment.
-     * Count down, followed by count up */
+     * Count down, followed by count up, a digit every 400ms */
+    Delay_setupTimer();
+    last = Delay_now() - DELAY_MS_TICKS(400); // First digit straight away
+    i = -16;
     while(1) {
-        INT8 i;
-        for (i = -16; i <= 16; i++) {
+        if (elapsed(last, 400)) {
             char sevseg = SEVEN_SEG_CA[ (i < 0) ? -i : i ];
+            last += DELAY_MS_TICKS(400);
             /* Set GPIO register to our value
              * GPIO address = 0x09 */
             MCP23008_write(0x09, sevseg);
-            Delay10KTCYx(100);
 
             LATB ^= 0x01; // blink LED for debugging
+            if (++i > 16) {
+                i = -16;
+            }
         }
     }
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#ifndef DEBOUNCE_LIB_H
+#define DEBOUNCE_LIB_H
+
+#include <GenericTypeDefs.h>
+
+/* Debouncing of up to 8 buttons at once, without blocking
+ *
+ * Debounce_tick() is called from a periodic tick (timer ISR) with a raw
+ * sample of 8 inputs, 1 = pressed; active-low buttons are passed inverted,
+ * e.g. Debounce_tick(~PORTA & 0x10). Each bit has a 2-bit counter, kept
+ * "vertically": bit n of debounce_ct0 and debounce_ct1 is the counter of
+ * input n, so all 8 are counted with a few logic instructions and no loop.
+ * An input has to read differently from its debounced state on 4 samples
+ * in a row before the state flips; any sample that agrees starts it again.
+ *
+ * Debounce_pressed() and Debounce_released() give the inputs that went down
+ * or up since the last call, and clear them. Edges are collected until
+ * read, so a slow main loop loses none. Debounce_state() is what is held
+ * down now.
+ *
+ * DEBOUNCE_MS is the debounce time and DEBOUNCE_TICK_US the period
+ * Debounce_tick() is called with. Only every DEBOUNCE_DIV-th tick is
+ * sampled, so that 4 samples cover at least DEBOUNCE_MS.
+ */
+
+#ifndef DEBOUNCE_MS
+#define DEBOUNCE_MS (20)
+#endif
+#ifndef DEBOUNCE_TICK_US
+#define DEBOUNCE_TICK_US (1000) // 1ms
+#endif
+#define DEBOUNCE_DIV ((DEBOUNCE_MS * 1000UL + 4 * DEBOUNCE_TICK_US - 1) / (4 * DEBOUNCE_TICK_US))
+#if DEBOUNCE_DIV > 255
+#error "DEBOUNCE_MS is too long for DEBOUNCE_TICK_US"
+#endif
+
+volatile UINT8 debounce_state = 0; // Debounced, 1 = pressed
+volatile UINT8 debounce_pressed = 0; // Edges not read yet
+volatile UINT8 debounce_released = 0;
+UINT8 debounce_ct0 = 0xFF; // Vertical counter, low bits
+UINT8 debounce_ct1 = 0xFF; // Vertical counter, high bits
+UINT8 debounce_div = 1;
+
+// Function prototype
+void Debounce_setup(UINT8 raw);
+void Debounce_tick(UINT8 raw);
+UINT8 Debounce_pressed(void);
+UINT8 Debounce_released(void);
+UINT8 Debounce_state(void);
+
+
+void Debounce_setup(UINT8 raw) {
+    /* Start from the inputs as they are, so nothing held at reset shows
+     * up as a press
+     */
+    UINT8 gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    debounce_state = raw;
+    debounce_pressed = 0;
+    debounce_released = 0;
+    debounce_ct0 = 0xFF;
+    debounce_ct1 = 0xFF;
+    debounce_div = 1;
+    INTCONbits.GIEH = gie;
+}
+
+void Debounce_tick(UINT8 raw) {
+    /* Call from the ISR every DEBOUNCE_TICK_US */
+    UINT8 changed;
+
+    if (--debounce_div) {
+        return;
+    }
+    debounce_div = DEBOUNCE_DIV;
+
+    changed = raw ^ debounce_state;
+    debounce_ct0 = ~(debounce_ct0 & changed); // Count down, or back to 11
+    debounce_ct1 = debounce_ct0 ^ (debounce_ct1 & changed);
+    changed &= debounce_ct0 & debounce_ct1; // Counted past 00: 4 samples
+    debounce_state ^= changed;
+    debounce_pressed |= changed & debounce_state;
+    debounce_released |= changed & ~debounce_state;
+}
+
+UINT8 Debounce_pressed(void) {
+    UINT8 edges;
+    UINT8 gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    edges = debounce_pressed;
+    debounce_pressed = 0;
+    INTCONbits.GIEH = gie;
+    return edges;
+}
+
+UINT8 Debounce_released(void) {
+    UINT8 edges;
+    UINT8 gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    edges = debounce_released;
+    debounce_released = 0;
+    INTCONbits.GIEH = gie;
+    return edges;
+}
+
+UINT8 Debounce_state(void) {
+    return debounce_state;
+}
+
+#endif
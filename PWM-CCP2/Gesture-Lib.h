@@ -0,0 +1,208 @@
+#ifndef GESTURE_LIB_H
+#define GESTURE_LIB_H
+
+#include <GenericTypeDefs.h>
+
+/* Button gestures as a queue of events
+ *
+ * Gesture_tick() is called from the ISR every DEBOUNCE_TICK_US with the raw
+ * button sample, 1 = pressed, button n in bit n. It runs it through
+ * Debounce_tick() and then follows each of the first GESTURE_BUTTONS
+ * debounced buttons through these steps:
+ *
+ *   press, release before GESTURE_LONG_MS, no press again within
+ *   GESTURE_DOUBLE_MS                                    GESTURE_CLICK
+ *   press again within GESTURE_DOUBLE_MS                 GESTURE_DOUBLE
+ *   held for GESTURE_LONG_MS                             GESTURE_LONG
+ *   still held, every repeat interval                    GESTURE_REPEAT
+ *
+ * The repeat interval starts at GESTURE_REPEAT_MS and loses 1/2^
+ * GESTURE_ACCEL_SHIFT of itself on each repeat, down to
+ * GESTURE_REPEAT_MIN_MS, so holding a button goes faster the longer it is
+ * held. A click is only known once the double click time has passed, so it
+ * comes that late; with GESTURE_DOUBLE_MS 0 there are no double clicks and
+ * a click comes on release.
+ *
+ * Each tick makes one pass over GESTURE_BUTTONS buttons, with no loop that
+ * depends on the input. The next repeat interval is worked out on every
+ * tick for every button, whatever its step, so a repeat only copies it and
+ * costs the same as a quiet tick. What still differs between ticks is a
+ * few instructions between the steps, and the Ring_put() of a tick that
+ * makes an event.
+ *
+ * Events go into a Ring (Ring-Lib.h) of GESTURE_QUEUE bytes for main to take
+ * with Gesture_get(), so neither side masks interrupts. When the queue is
+ * full, new events are dropped and counted in gesture_ring.dropped.
+ *
+ * Debounce-Lib.h and Ring-Lib.h must be included before this file.
+ */
+
+#ifndef DEBOUNCE_LIB_H
+#error "Debounce-Lib.h must be included before Gesture-Lib.h"
+#endif
+#ifndef RING_LIB_H
+#error "Ring-Lib.h must be included before Gesture-Lib.h"
+#endif
+#ifndef GESTURE_BUTTONS
+#define GESTURE_BUTTONS (1)
+#endif
+#ifndef GESTURE_QUEUE
+#define GESTURE_QUEUE (8)
+#endif
+#if (GESTURE_QUEUE & (GESTURE_QUEUE - 1)) || GESTURE_QUEUE < 2 || GESTURE_QUEUE > 128
+#error "GESTURE_QUEUE must be a power of 2 from 2 to 128"
+#endif
+#ifndef GESTURE_LONG_MS
+#define GESTURE_LONG_MS (600)
+#endif
+#ifndef GESTURE_DOUBLE_MS
+#define GESTURE_DOUBLE_MS (250)
+#endif
+#ifndef GESTURE_REPEAT_MS
+#define GESTURE_REPEAT_MS (200)
+#endif
+#ifndef GESTURE_REPEAT_MIN_MS
+#define GESTURE_REPEAT_MIN_MS (25)
+#endif
+#ifndef GESTURE_ACCEL_SHIFT
+#define GESTURE_ACCEL_SHIFT (3) // 1/8 faster per repeat
+#endif
+
+#define GESTURE_TICKS(ms) (((ms) * 1000UL + DEBOUNCE_TICK_US / 2) / DEBOUNCE_TICK_US)
+
+/* Event types */
+#define GESTURE_CLICK  (1)
+#define GESTURE_DOUBLE (2)
+#define GESTURE_LONG   (3)
+#define GESTURE_REPEAT (4)
+
+/* Steps of a button */
+#define GESTURE_UP     (0) // Nothing going on
+#define GESTURE_DOWN   (1) // Pressed, not long yet
+#define GESTURE_GAP    (2) // Released, waiting for a second press
+#define GESTURE_SECOND (3) // Second press of a double click
+#define GESTURE_HELD   (4) // Long press, repeating
+
+typedef struct {
+    UINT8 type;
+    UINT8 button;
+} GestureEvent;
+
+UINT8 gesture_step[GESTURE_BUTTONS];
+UINT16 gesture_time[GESTURE_BUTTONS]; // Ticks in this step, or to the next repeat
+UINT16 gesture_interval[GESTURE_BUTTONS]; // Repeat interval, ticks
+UINT8 gesture_buf[GESTURE_QUEUE]; // type << 4 | button
+Ring gesture_ring;
+
+// Function prototype
+void Gesture_setup(UINT8 raw);
+void Gesture_tick(UINT8 raw);
+void Gesture_put(UINT8 type, UINT8 button);
+BOOL Gesture_pending(void);
+BOOL Gesture_get(GestureEvent *e);
+
+
+void Gesture_setup(UINT8 raw) {
+    /* Call with interrupts off, with the buttons as they are now */
+    UINT8 i;
+    Debounce_setup(raw);
+    for (i = 0; i < GESTURE_BUTTONS; i++) {
+        // Anything held at reset has to be let go before it counts
+        gesture_step[i] = (raw & (1 << i)) ? GESTURE_SECOND : GESTURE_UP;
+        gesture_time[i] = 0;
+        gesture_interval[i] = GESTURE_TICKS(GESTURE_REPEAT_MS);
+    }
+    Ring_init(&gesture_ring, gesture_buf, GESTURE_QUEUE);
+}
+
+void Gesture_put(UINT8 type, UINT8 button) {
+    /* From the ISR only */
+    Ring_put(&gesture_ring, (type << 4) | button);
+}
+
+void Gesture_tick(UINT8 raw) {
+    UINT8 i, held;
+
+    Debounce_tick(raw);
+    held = debounce_state;
+
+    for (i = 0; i < GESTURE_BUTTONS; i++, held >>= 1) {
+        UINT16 next;
+        gesture_time[i]++;
+
+        // Accelerate, on every tick so that a repeat costs no more
+        next = gesture_interval[i] - (gesture_interval[i] >> GESTURE_ACCEL_SHIFT);
+        if (next < GESTURE_TICKS(GESTURE_REPEAT_MIN_MS)) {
+            next = GESTURE_TICKS(GESTURE_REPEAT_MIN_MS);
+        }
+
+        switch (gesture_step[i]) {
+            case GESTURE_UP:
+                if (held & 1) {
+                    gesture_step[i] = GESTURE_DOWN;
+                    gesture_time[i] = 0;
+                }
+                break;
+
+            case GESTURE_DOWN:
+                if (!(held & 1)) {
+#if GESTURE_DOUBLE_MS > 0
+                    gesture_step[i] = GESTURE_GAP;
+                    gesture_time[i] = 0;
+#else
+                    gesture_step[i] = GESTURE_UP;
+                    Gesture_put(GESTURE_CLICK, i);
+#endif
+                } else if (gesture_time[i] >= GESTURE_TICKS(GESTURE_LONG_MS)) {
+                    gesture_step[i] = GESTURE_HELD;
+                    gesture_interval[i] = GESTURE_TICKS(GESTURE_REPEAT_MS);
+                    gesture_time[i] = 0;
+                    Gesture_put(GESTURE_LONG, i);
+                }
+                break;
+
+            case GESTURE_GAP:
+                if (held & 1) {
+                    gesture_step[i] = GESTURE_SECOND;
+                    Gesture_put(GESTURE_DOUBLE, i);
+                } else if (gesture_time[i] >= GESTURE_TICKS(GESTURE_DOUBLE_MS)) {
+                    gesture_step[i] = GESTURE_UP;
+                    Gesture_put(GESTURE_CLICK, i);
+                }
+                break;
+
+            case GESTURE_SECOND:
+                if (!(held & 1)) {
+                    gesture_step[i] = GESTURE_UP;
+                }
+                break;
+
+            case GESTURE_HELD:
+                if (!(held & 1)) {
+                    gesture_step[i] = GESTURE_UP;
+                } else if (gesture_time[i] >= gesture_interval[i]) {
+                    gesture_time[i] = 0;
+                    gesture_interval[i] = next;
+                    Gesture_put(GESTURE_REPEAT, i);
+                }
+                break;
+        }
+    }
+}
+
+BOOL Gesture_pending(void) {
+    return Ring_count(&gesture_ring) != 0;
+}
+
+BOOL Gesture_get(GestureEvent *e) {
+    /* From main only. FALSE when the queue is empty */
+    UINT8 v;
+    if (!Ring_get(&gesture_ring, &v)) {
+        return FALSE;
+    }
+    e->type = v >> 4;
+    e->button = v & 0x0F;
+    return TRUE;
+}
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef IRQ_LIB_H
+#define IRQ_LIB_H
+
+#include <GenericTypeDefs.h>
+
+/* Two-priority interrupt dispatch (IPEN = 1)
+ *
+ * Irq_register() routes one interrupt source to a handler at high or low
+ * priority, by its IP bit. This file holds both vectors and both ISRs, so
+ * a project including it must not define its own:
+ *   0x08 high  #pragma interrupt, returns with RETFIE FAST: WREG, STATUS
+ *              and BSR are kept in the shadow registers, not in software.
+ *              The prologue still pushes FSR0 and FSR2 on the software
+ *              stack, sets up a frame, and copies the save= sections
+ *              (.tmpdata, and PROD and MATH_DATA with IRQ_HIGH_MATH) byte
+ *              by byte, all undone again in the epilogue
+ *   0x18 low   #pragma interruptlow, saves its context in software, as the
+ *              shadow registers are overwritten if a high interrupt comes
+ *              in on top of it. WREG, STATUS, BSR, FSR0 and FSR2 are
+ *              pushed, then PROD, .tmpdata and MATH_DATA, so low handlers
+ *              can do any maths
+ * A high interrupt can stop a low handler at any point, never the other
+ * way round, so a display or PWM handler on high waits at most for the
+ * other high handlers, never for an A/D or capture handler on low.
+ *
+ * The high ISR saves .tmpdata only. Define IRQ_HIGH_MATH when a high
+ * handler multiplies or does 32-bit maths, to save PROD and MATH_DATA too.
+ *
+ * Each ISR checks its sources in the fixed order below, as unrolled tests,
+ * so the time to reach a handler does not depend on what is registered.
+ * A handler is called while IE and IF are both set, and clears IF itself,
+ * as in the ISRs so far.
+ *
+ * INT0 has no priority bit and is always high. GIEH = 0 still masks both
+ * priorities, so the GIEH save/clear/restore sections in the other libs
+ * stay atomic. With IPEN = 1, INTCON<6> is GIEL instead of PEIE.
+ */
+
+#define IRQ_INT0 (0) // Always high
+#define IRQ_INT1 (1)
+#define IRQ_INT2 (2)
+#define IRQ_TMR0 (3)
+#define IRQ_TMR1 (4)
+#define IRQ_TMR2 (5)
+#define IRQ_TMR3 (6)
+#define IRQ_CCP1 (7)
+#define IRQ_CCP2 (8)
+#define IRQ_AD   (9)
+#define IRQ_SSP  (10)
+#define IRQ_RB   (11)
+#define IRQ_SOURCES (12)
+
+#define IRQ_LOW  (0)
+#define IRQ_HIGH (1)
+
+typedef void (*IrqFunc)(void);
+
+IrqFunc irq_handler[IRQ_SOURCES];
+UINT16 irq_high = 0; // One bit per source registered at high priority
+UINT16 irq_low = 0; // One bit per source registered at low priority
+
+// Function prototype
+void Irq_setup(void);
+BOOL Irq_register(UINT8 src, IrqFunc f, UINT8 priority);
+void Irq_enable(void);
+void Irq_dispatch(UINT16 sources);
+void Irq_high(void);
+void Irq_low(void);
+
+
+void Irq_setup(void) {
+    /* Call before any Irq_register(), with interrupts off */
+    UINT8 i;
+    INTCONbits.GIEH = 0;
+    for (i = 0; i < IRQ_SOURCES; i++) {
+        irq_handler[i] = 0;
+    }
+    irq_high = 0;
+    irq_low = 0;
+    RCONbits.IPEN = 1; // 1 = Enable priority levels on interrupts
+}
+
+BOOL Irq_register(UINT8 src, IrqFunc f, UINT8 priority) {
+    /* Route src to f. The source's own IE bit is left to its driver.
+     * FALSE for an unknown source, or INT0 asked for low priority.
+     */
+    UINT8 gie;
+    UINT8 ip = (priority == IRQ_HIGH);
+
+    if (src >= IRQ_SOURCES || (src == IRQ_INT0 && !ip)) {
+        return FALSE;
+    }
+
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    switch (src) {
+        case IRQ_INT1: INTCON3bits.INT1IP = ip; break;
+        case IRQ_INT2: INTCON3bits.INT2IP = ip; break;
+        case IRQ_TMR0: INTCON2bits.TMR0IP = ip; break;
+        case IRQ_TMR1: IPR1bits.TMR1IP = ip; break;
+        case IRQ_TMR2: IPR1bits.TMR2IP = ip; break;
+        case IRQ_TMR3: IPR2bits.TMR3IP = ip; break;
+        case IRQ_CCP1: IPR1bits.CCP1IP = ip; break;
+        case IRQ_CCP2: IPR2bits.CCP2IP = ip; break;
+        case IRQ_AD:   IPR1bits.ADIP = ip; break;
+        case IRQ_SSP:  IPR1bits.SSPIP = ip; break;
+        case IRQ_RB:   INTCON2bits.RBIP = ip; break;
+    }
+    irq_handler[src] = f;
+    if (ip) {
+        irq_high |= 1 << src;
+        irq_low &= ~(1 << src);
+    } else {
+        irq_low |= 1 << src;
+        irq_high &= ~(1 << src);
+    }
+    INTCONbits.GIEH = gie;
+    return TRUE;
+}
+
+void Irq_enable(void) {
+    INTCONbits.GIEL = 1; // 1 = Enables all low priority interrupts
+    INTCONbits.GIEH = 1; // 1 = Enables all high priority interrupts
+}
+
+#define IRQ_CHECK(src, ie, iflag) \
+    if ((sources & (1 << (src))) && (ie) && (iflag)) { irq_handler[src](); }
+
+void Irq_dispatch(UINT16 sources) {
+    IRQ_CHECK(IRQ_INT0, INTCONbits.INT0IE, INTCONbits.INT0IF)
+    IRQ_CHECK(IRQ_INT1, INTCON3bits.INT1IE, INTCON3bits.INT1IF)
+    IRQ_CHECK(IRQ_INT2, INTCON3bits.INT2IE, INTCON3bits.INT2IF)
+    IRQ_CHECK(IRQ_TMR0, INTCONbits.TMR0IE, INTCONbits.TMR0IF)
+    IRQ_CHECK(IRQ_TMR1, PIE1bits.TMR1IE, PIR1bits.TMR1IF)
+    IRQ_CHECK(IRQ_TMR2, PIE1bits.TMR2IE, PIR1bits.TMR2IF)
+    IRQ_CHECK(IRQ_TMR3, PIE2bits.TMR3IE, PIR2bits.TMR3IF)
+    IRQ_CHECK(IRQ_CCP1, PIE1bits.CCP1IE, PIR1bits.CCP1IF)
+    IRQ_CHECK(IRQ_CCP2, PIE2bits.CCP2IE, PIR2bits.CCP2IF)
+    IRQ_CHECK(IRQ_AD, PIE1bits.ADIE, PIR1bits.ADIF)
+    IRQ_CHECK(IRQ_SSP, PIE1bits.SSPIE, PIR1bits.SSPIF)
+    IRQ_CHECK(IRQ_RB, INTCONbits.RBIE, INTCONbits.RBIF)
+}
+
+//----------------------------------------------------------------------------
+// High priority interrupt vector
+
+#pragma code InterruptVectorHigh = 0x08
+void InterruptVectorHigh(void) {
+    _asm
+    goto Irq_high
+    _endasm
+}
+
+//----------------------------------------------------------------------------
+// Low priority interrupt vector
+
+#pragma code InterruptVectorLow = 0x18
+void InterruptVectorLow(void) {
+    _asm
+    goto Irq_low
+    _endasm
+}
+
+//----------------------------------------------------------------------------
+// High priority interrupt routine
+
+#pragma code
+#ifdef IRQ_HIGH_MATH
+#pragma interrupt Irq_high save=PROD,section(".tmpdata"),section("MATH_DATA")
+#else
+#pragma interrupt Irq_high save=section(".tmpdata")
+#endif
+void Irq_high(void) {
+    Irq_dispatch(irq_high);
+}
+
+//----------------------------------------------------------------------------
+// Low priority interrupt routine
+
+#pragma interruptlow Irq_low save=PROD,section(".tmpdata"),section("MATH_DATA")
+void Irq_low(void) {
+    Irq_dispatch(irq_low);
+}
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef PWM_LIB_H
+#define PWM_LIB_H
+
+#include <GenericTypeDefs.h>
+
+/* PWM library for CCP1 (Enhanced CCP) and CCP2
+ *
+ * Both modules share Timer2 as the PWM time base, so the frequency is set once
+ * for both and each module only has its own duty cycle.
+ *
+ * FOSC must be defined (in Hz, as an integer) before including this file:
+ *   #define FOSC (40000000UL) // 10MHz crystal in HSPLL mode
+ *
+ * ECCP output pins on the PIC18F4520:
+ *     RC2 -> P1A
+ *     RD5 -> P1B
+ *     RD6 -> P1C
+ *     RD7 -> P1D
+ * The PIC18F4520 has no pulse steering register (PSTRCON), so "steering" is
+ * the forward/reverse direction select of the full-bridge mode.
+ */
+
+#ifndef FOSC
+#error "FOSC must be defined before including PWM-Lib.h"
+#endif
+
+#define PWM_CCP1 (1)
+#define PWM_CCP2 (2)
+
+/* CCP1CONbits.P1M */
+#define ECCP_SINGLE       (0b00) // P1A modulated, P1B:P1D are port pins
+#define ECCP_FULL_FORWARD (0b01) // P1D modulated, P1A active, P1B, P1C inactive
+#define ECCP_HALF_BRIDGE  (0b10) // P1A, P1B modulated with dead-band control
+#define ECCP_FULL_REVERSE (0b11) // P1B modulated, P1C active, P1A, P1D inactive
+
+/* CCP1CONbits.CCP1M (PWM modes) */
+#define ECCP_AC_HIGH_BD_HIGH (0b1100)
+#define ECCP_AC_HIGH_BD_LOW  (0b1101)
+#define ECCP_AC_LOW_BD_HIGH  (0b1110)
+#define ECCP_AC_LOW_BD_LOW   (0b1111)
+
+/* ECCP1ASbits.ECCPAS - auto-shutdown source */
+#define ECCP_AS_DISABLED  (0b000)
+#define ECCP_AS_C1        (0b001)
+#define ECCP_AS_C2        (0b010)
+#define ECCP_AS_C1_C2     (0b011)
+#define ECCP_AS_INT0      (0b100)
+#define ECCP_AS_INT0_C1   (0b101)
+#define ECCP_AS_INT0_C2   (0b110)
+#define ECCP_AS_INT0_C1_C2 (0b111)
+
+/* ECCP1ASbits.PSSAC / PSSBD - pin state while shut down */
+#define ECCP_SHUTDOWN_LOW   (0b00)
+#define ECCP_SHUTDOWN_HIGH  (0b01)
+#define ECCP_SHUTDOWN_TRIS  (0b10)
+
+// Function prototype
+BOOL PWM_setFrequency(UINT32 freq);
+UINT16 PWM_getFullScale(void);
+void PWM_setDutyRaw(UINT8 ccp, UINT16 duty);
+void PWM_setDutyCycle(UINT8 ccp, UINT8 pwm_percentage);
+void PWM_enable(UINT8 ccp);
+void PWM_disable(UINT8 ccp);
+void ECCP_setMode(UINT8 mode, UINT8 polarity);
+void ECCP_setDirection(BOOL forward);
+UINT8 ECCP_setDeadBand(UINT16 ns);
+void ECCP_setAutoShutdown(UINT8 source, UINT8 pssac, UINT8 pssbd, BOOL auto_restart);
+BOOL ECCP_isShutdown(void);
+void ECCP_clearShutdown(void);
+
+
+BOOL PWM_setFrequency(UINT32 freq) {
+    /* Calculation for PWM Period
+     *   PWM Period = [(PR2) + 1] * 4 * TOSC * (TMR2 Prescale Value)
+     *   PR2 = FOSC / (4 * freq * Prescale) - 1
+     *
+     * The smallest prescaler that fits PR2 in 8 bits is picked, as that
+     * gives the most duty cycle resolution.
+     */
+    UINT32 cycles;
+    UINT8 prescale_bits = 0b00; // 00 = Prescaler is 1
+
+    if (freq == 0) {
+        return FALSE;
+    }
+    cycles = (FOSC / 4 + freq / 2) / freq; // Tcy per PWM period, rounded
+
+    if (cycles > 256) {
+        cycles = (cycles + 2) / 4;
+        prescale_bits = 0b01; // 01 = Prescaler is 4
+    }
+    if (cycles > 256) {
+        cycles = (cycles + 2) / 4;
+        prescale_bits = 0b10; // 1x = Prescaler is 16
+    }
+    if (cycles > 256 || cycles < 2) {
+        return FALSE; // Out of range for this FOSC
+    }
+
+    T2CONbits.T2CKPS = prescale_bits;
+    PR2 = cycles - 1;
+    T2CONbits.TMR2ON = 1; // 1 = Timer2 is on
+    return TRUE;
+}
+
+UINT16 PWM_getFullScale(void) {
+    /* Duty value (CCPRxL:CCPxCON<5:4>) that equals 100% duty cycle
+     *   Full scale = [(PR2) + 1] * 4
+     */
+    return ((UINT16) PR2 + 1) << 2;
+}
+
+void PWM_setDutyRaw(UINT8 ccp, UINT16 duty) {
+    /* 10-bit duty value: 8 MSbs in CCPRxL, 2 LSbs in CCPxCON<5:4>
+     * The new value is latched into the module at the next period.
+     * The two parts are separate writes, CCPRxL first: a period that ends
+     * between them gets the new 8 MSbs with the old 2 LSbs, so it is at
+     * most 3 counts from the new duty, for that one period.
+     */
+    if (ccp == PWM_CCP1) {
+        CCPR1L = duty >> 2;
+        CCP1CONbits.DC1B = 0b11 & duty; // DCxB<1:0>: bits 0, 1
+    } else {
+        CCPR2L = duty >> 2;
+        CCP2CONbits.DC2B = 0b11 & duty; // DCxB<1:0>: bits 0, 1
+    }
+}
+
+void PWM_setDutyCycle(UINT8 ccp, UINT8 pwm_percentage) {
+    /* Calculation for PWM Duty Cycle
+     *   (CCPRXL:CCPXCON<5:4>) = Ratio * [(PR2) + 1] * 4]
+     * Integer only, rounded to the nearest step.
+     */
+    UINT32 duty = (UINT32) pwm_percentage * PWM_getFullScale();
+    PWM_setDutyRaw(ccp, (duty + 50) / 100);
+}
+
+void PWM_enable(UINT8 ccp) {
+    if (ccp == PWM_CCP1) {
+        TRISCbits.TRISC2 = 0; // P1A
+        if (CCP1CONbits.P1M != ECCP_SINGLE) {
+            TRISDbits.TRISD5 = 0; // P1B
+        }
+        if (CCP1CONbits.P1M == ECCP_FULL_FORWARD || CCP1CONbits.P1M == ECCP_FULL_REVERSE) {
+            TRISDbits.TRISD6 = 0; // P1C
+            TRISDbits.TRISD7 = 0; // P1D
+        }
+        if (CCP1CONbits.CCP1M < ECCP_AC_HIGH_BD_HIGH) {
+            CCP1CONbits.CCP1M = ECCP_AC_HIGH_BD_HIGH; // 11xx = PWM mode
+        }
+    } else {
+        TRISCbits.TRISC1 = 0; // RC1/T1OSI/CCP2
+        CCP2CONbits.CCP2M = 0b1100; // 11xx = PWM mode
+    }
+}
+
+void PWM_disable(UINT8 ccp) {
+    if (ccp == PWM_CCP1) {
+        CCP1CON = 0; // 0000 = Capture/Compare/PWM off, P1M = single output
+    } else {
+        CCP2CONbits.CCP2M = 0b0000;
+    }
+}
+
+void ECCP_setMode(UINT8 mode, UINT8 polarity) {
+    /* CCP1CON:
+     * (bit 7:6) P1M = output configuration
+     * (bit 5:4) DC1B = duty cycle LSbs (untouched)
+     * (bit 3:0) CCP1M = PWM polarity of P1A/P1C and P1B/P1D
+     */
+    CCP1CONbits.P1M = mode;
+    CCP1CONbits.CCP1M = polarity;
+}
+
+void ECCP_setDirection(BOOL forward) {
+    /* Full-bridge direction change takes effect at the end of the current
+     * PWM period. The caller must already be in a full-bridge mode.
+     */
+    CCP1CONbits.P1M = forward ? ECCP_FULL_FORWARD : ECCP_FULL_REVERSE;
+}
+
+UINT8 ECCP_setDeadBand(UINT16 ns) {
+    /* PWM1CON<6:0> PDC = number of Tcy (FOSC/4) between the scheduled and
+     * actual time for the PWM signal to go active (half-bridge only).
+     *   PDC = ns * (FOSC / 4) / 1e9, rounded up so the dead-band is never
+     *   shorter than asked for. Limited to 127 Tcy.
+     *   e.g. 40MHz -> Tcy = 100ns, 250ns -> PDC = 3
+     */
+    UINT32 pdc = ((UINT32) ns * (FOSC / 4000) + 999999) / 1000000;
+    if (pdc > 127) {
+        pdc = 127;
+    }
+    PWM1CONbits.PDC = pdc;
+    return pdc;
+}
+
+void ECCP_setAutoShutdown(UINT8 source, UINT8 pssac, UINT8 pssbd, BOOL auto_restart) {
+    /* ECCP1AS:
+     * (bit 7) ECCPASE = 1 when outputs are shut down
+     * (bit 6:4) ECCPAS = shutdown source
+     * (bit 3:2) PSSAC = P1A/P1C state while shut down
+     * (bit 1:0) PSSBD = P1B/P1D state while shut down
+     * PWM1CON (bit 7) PRSEN = 1 restarts automatically once the fault is gone
+     */
+    ECCP1ASbits.ECCPAS = source;
+    ECCP1ASbits.PSSAC = pssac;
+    ECCP1ASbits.PSSBD = pssbd;
+    PWM1CONbits.PRSEN = auto_restart;
+}
+
+BOOL ECCP_isShutdown(void) {
+    return ECCP1ASbits.ECCPASE;
+}
+
+void ECCP_clearShutdown(void) {
+    /* Only has effect once the shutdown source is no longer active,
+     * outputs resume at the start of the next PWM period
+     */
+    ECCP1ASbits.ECCPASE = 0;
+}
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef PWM_RAMP_H
+#define PWM_RAMP_H
+
+#include <GenericTypeDefs.h>
+#include "PWM-Lib.h"
+
+/* Soft-start / duty ramp engine for one PWM channel
+ *
+ * The Timer2 postscaler raises TMR2IF once every RAMP postscale PWM periods,
+ * right after the PR2 match that starts a new period. Ramp_tick() is called
+ * from the ISR on TMR2IF and moves the 10-bit duty one step towards the
+ * target every `ticks` interrupts, so one step happens every
+ * (postscale * ticks) PWM periods.
+ *
+ * The ISR starts after a period boundary, but whether the duty is written
+ * before the next one depends on the PWM period: at 500kHz with PR2 = 19 a
+ * period is 20 Tcy, less than getting into the ISR, so the write lands at
+ * some point of a later period. Updates are then not synchronised to a
+ * period boundary; for that the period must be longer than the ISR entry
+ * and the write. PWM_setDutyRaw() writes CCPRxL and then DCxB, so when a
+ * period ends between the two, that one period runs with the new 8 MSbs
+ * and the old 2 LSbs, at most 3 counts from the new duty, and the next
+ * one has the whole new value.
+ *
+ * Curves:
+ *   RAMP_LINEAR      -> duty moves by a fixed `step` per ramp step
+ *   RAMP_EXPONENTIAL -> duty moves by (distance >> RAMP_EXP_SHIFT), at least 1
+ *
+ * Ramp_tick() has no loops, so its cost is the same on every tick.
+ *
+ * With no ramp running, Ramp_tick() turns TMR2IE off so an idle CPU is not
+ * woken on every tick. Ramp_setTarget() turns it back on.
+ */
+
+#ifndef RAMP_EXP_SHIFT
+#define RAMP_EXP_SHIFT (3) // Move 1/8 of the remaining distance per step
+#endif
+
+#define RAMP_LINEAR      (0)
+#define RAMP_EXPONENTIAL (1)
+
+volatile UINT16 ramp_duty = 0;
+volatile UINT16 ramp_target = 0;
+volatile UINT16 ramp_step = 1;
+volatile UINT8 ramp_ticks = 1;
+volatile UINT8 ramp_count = 1;
+volatile UINT8 ramp_curve = RAMP_LINEAR;
+volatile BOOL ramp_busy = FALSE;
+UINT8 ramp_ccp = PWM_CCP2;
+
+// Function prototype
+void Ramp_setup(UINT8 ccp, UINT8 postscale);
+void Ramp_setTarget(UINT16 target, UINT16 step, UINT8 ticks, UINT8 curve);
+void Ramp_setDutyNow(UINT16 duty);
+BOOL Ramp_isDone(void);
+void Ramp_tick(void);
+
+
+void Ramp_setup(UINT8 ccp, UINT8 postscale) {
+    /* T2CON<6:3> T2OUTPS = postscale - 1 (0000 = 1:1 ... 1111 = 1:16) */
+    ramp_ccp = ccp;
+    T2CONbits.T2OUTPS = (postscale - 1) & 0x0F;
+
+    PIR1bits.TMR2IF = 0; // Clear flag
+    PIE1bits.TMR2IE = 1; // Enable Timer2 to PR2 match interrupt
+    INTCONbits.PEIE = 1; // Enable peripheral interrupts
+}
+
+void Ramp_setTarget(UINT16 target, UINT16 step, UINT8 ticks, UINT8 curve) {
+    if (target > PWM_getFullScale()) {
+        target = PWM_getFullScale();
+    }
+    if (step == 0) {
+        step = 1;
+    }
+    if (ticks == 0) {
+        ticks = 1;
+    }
+
+    PIE1bits.TMR2IE = 0; // Keep the ISR out while the ramp is changed
+    ramp_target = target;
+    ramp_step = step;
+    ramp_ticks = ticks;
+    ramp_count = ticks;
+    ramp_curve = curve;
+    ramp_busy = (ramp_duty != target);
+    PIE1bits.TMR2IE = 1;
+}
+
+void Ramp_setDutyNow(UINT16 duty) {
+    /* Jump straight to a duty value, cancelling any ramp */
+    PIE1bits.TMR2IE = 0;
+    ramp_duty = duty;
+    ramp_target = duty;
+    ramp_busy = FALSE;
+    PWM_setDutyRaw(ramp_ccp, duty);
+    PIE1bits.TMR2IE = 1;
+}
+
+BOOL Ramp_isDone(void) {
+    return !ramp_busy;
+}
+
+void Ramp_tick(void) {
+    UINT16 distance, delta;
+
+    if (!ramp_busy) {
+        PIE1bits.TMR2IE = 0; // Nothing to do until the next target
+        return;
+    }
+    if (--ramp_count != 0) {
+        return;
+    }
+    ramp_count = ramp_ticks;
+
+    if (ramp_duty < ramp_target) {
+        distance = ramp_target - ramp_duty;
+    } else {
+        distance = ramp_duty - ramp_target;
+    }
+
+    if (ramp_curve == RAMP_EXPONENTIAL) {
+        delta = distance >> RAMP_EXP_SHIFT;
+        if (delta == 0) {
+            delta = 1;
+        }
+    } else {
+        delta = ramp_step;
+    }
+
+    if (delta >= distance) {
+        ramp_duty = ramp_target;
+        ramp_busy = FALSE;
+    } else if (ramp_duty < ramp_target) {
+        ramp_duty += delta;
+    } else {
+        ramp_duty -= delta;
+    }
+
+    PWM_setDutyRaw(ramp_ccp, ramp_duty);
+}
+
+#endif
@@ -3,16 +3,57 @@
  * PIC18F4520
  * 
  * Generate a 500kHz PWM waveform using CCP2 on RC1.
- * Push button on RB0 will trigger an interrupt and
- * increment the duty cycle from 0% to 100% in 
- * steps of 10%. The clock is set to HSPLL with a
- * 10MHz crystal (Fosc = 40MHz)
+ * Push buttons on RB0 (up) and RA4 (down) set the
+ * duty cycle (Gesture-Lib.h):
+ *   click         step by 10%, wrapping at 0% / 100%
+ *   hold          ramp by 1% per repeat, faster and
+ *                 faster, while the button is held
+ *   double click  straight to 100% (up) or 0% (down)
+ * The clock is set to HSPLL with a 10MHz crystal
+ * (Fosc = 40MHz)
+ *
+ * Each new duty cycle is reached with a soft ramp
+ * instead of an instant step. The Timer2 postscaler
+ * interrupt moves the duty one count every
+ * RAMP_POSTSCALE * RAMP_TICKS PWM periods.
+ *
+ * Between events the CPU idles (Power-Lib.h). IDLE, not
+ * SLEEP, as Timer2 has to keep clocking the PWM. Timer1 runs
+ * from Tcy, RC1 is the PWM output and can not take the 32kHz
+ * crystal. It wakes the CPU every 2.56ms to sample the
+ * buttons, main only runs when there is an event.
+ *
+ * Interrupts go through Irq-Lib.h with priorities: the ramp
+ * tick (Timer2) is high so it is never held up by the
+ * Timer1 button tick, which is low. At 500kHz a PWM period
+ * (20 Tcy) is shorter than the ISR entry, so the duty is
+ * written somewhere in a later period, not synchronised to
+ * a boundary: a period caught between the two writes is at
+ * most 3 counts off (see PWM-Ramp.h).
  */
 
 #include <p18f4520.h>
 #include <delays.h>
 #include <GenericTypeDefs.h>
 
+#define FOSC (40000000UL) // 40MHz HSPLL mode
+#include "PWM-Lib.h"
+#include "PWM-Ramp.h"
+#define POWER_CLOCK_TCY // RC1 is CCP2, not T1OSI
+#define POWER_WAKE_TICKS (25600) // 2.56ms at 10MHz Tcy
+#include "Power-Lib.h"
+#include "Irq-Lib.h"
+
+#define DEBOUNCE_TICK_US (POWER_WAKE_TICKS * 15625UL / (POWER_TICK_HZ / 64))
+#include "Debounce-Lib.h"
+#include "Ring-Lib.h"
+#define GESTURE_BUTTONS (2)
+#include "Gesture-Lib.h"
+
+#define BUTTON_UP   (0) // RB0, active low
+#define BUTTON_DOWN (1) // RA4, active low
+#define buttons() ((PORTBbits.RB0 ? 0 : 1 << BUTTON_UP) | (PORTAbits.RA4 ? 0 : 1 << BUTTON_DOWN))
+
 /* Calculation for PWM Period
  *   PWM Period = [(PR2) + 1]  4  TOSC  (TMR2 Prescale Value)
  *   500kHz freq = 2us
@@ -20,21 +61,36 @@
  *   PR2+1 = 20 -> PR2 = 19dec
  */
 
-#define round(x) ((x) + 0.5)
-#define PWM_PERIOD (19)	
-BOOL RB0_Pressed = FALSE;
+#define PWM_FREQ (500000) // 500kHz -> PR2 = 19
+
+/* Ramp speed
+ *   TMR2IF every 16 periods -> 500kHz / 16 = 31.25kHz
+ *   1 duty count per 250 ticks -> 125 counts per second
+ *   10% of the 80 count full scale takes 64ms
+ */
+#define RAMP_POSTSCALE (16)
+#define RAMP_TICKS (250)
+#define RAMP_STEP (1)
 
-void ISR();
+void onButtonTick(void);
+void onRampTick(void);
 void updateCCP2DutyCycle(int pwm_percentage);
 
 void main(void) {
 	int pwm_percentage;
+	GestureEvent ev;
 	
-	// Set up RB0 push button external interrupt
+	// Interrupt sources and their priority
+	Irq_setup();
+	Irq_register(IRQ_TMR2, onRampTick, IRQ_HIGH);
+	Irq_register(IRQ_TMR1, onButtonTick, IRQ_LOW);
+	
+	// Push buttons, sampled on the Timer1 tick
 	TRISB = 1<<0; // RB0 as input
-	INTCONbits.INT0IE = 1; // INT0 enabled	
-	INTCON2bits.INTEDG0 = 0; // Interrupt on falling edge
-	INTCONbits.GIEH = 1;// Enable global interrupts
+	TRISA |= 1<<4; // RA4 as input
+	Gesture_setup(buttons());
+	Power_setup(); // Timer1 button tick
+	Irq_enable(); // Enable high and low priority interrupts
 	
 	/****************************************************
 	The following steps should be taken when configuring
@@ -50,30 +106,66 @@ void main(void) {
 	****************************************************/
 	
 	// 1. Set the PWM period by writing to the PR2 register.
-	PR2 = PWM_PERIOD;
+	// 4. Set up TMR2 (the prescaler is picked to fit PR2)
+	PWM_setFrequency(PWM_FREQ);
 	
 	// 2. Set the PWM duty cycle by writing to the CCPRxL register and CCPxCON<5:4> bits.
-	pwm_percentage = 10;
-	updateCCP2DutyCycle(pwm_percentage); // Set PWM duty cycle to 10%
+	Ramp_setup(PWM_CCP2, RAMP_POSTSCALE);
+	Ramp_setDutyNow(0); // Soft-start from 0%
 	
 	// 3. Make the CCPx pin an output by clearing the appropriate TRIS bit.
-	// Set RC1 to output: RC1/T1OSI/CCP2(1)
-	TRISCbits.RC1 = 0;
-	
-	// 4. Set up TMR2
-	T2CONbits.T2CKPS = 0b00; // 00 = Prescaler is 1 
-	T2CONbits.TMR2ON = 1; // 1 = Timer2 is on
-	
 	// 5. Configure the CCPx module for PWM operation.
-	CCP2CONbits.CCP2M = 0b1100; // CCP2 as PWM mode -> 11xx = PWM mode
+	PWM_enable(PWM_CCP2);
+	
+	// Ramp up to 10%
+	pwm_percentage = 10;
+	updateCCP2DutyCycle(pwm_percentage);
 	
 	while (1) {
-		if (RB0_Pressed) {
-			RB0_Pressed = FALSE;
-			if (pwm_percentage >= 100) { // reset back to 0 if already 100%
+		// Idle until the next button event, checked with interrupts off
+		INTCONbits.GIEH = 0;
+		if (!Gesture_pending()) {
+			Power_idle(POWER_IDLE);
+		}
+		INTCONbits.GIEH = 1; // Pending ISR runs here
+
+		while (Gesture_get(&ev)) {
+			switch (ev.type) {
+				case GESTURE_CLICK:
+					if (ev.button == BUTTON_UP) {
+						if (pwm_percentage >= 100) { // reset back to 0 if already 100%
+							pwm_percentage = 0;
+						} else { // increment duty cycle by 10%
+							pwm_percentage += 10;
+						}
+					} else {
+						if (pwm_percentage <= 0) { // wrap to 100% if already 0%
+							pwm_percentage = 100;
+						} else { // decrement duty cycle by 10%
+							pwm_percentage -= 10;
+						}
+					}
+					break;
+				
+				case GESTURE_LONG:
+				case GESTURE_REPEAT: // Hold to ramp, 1% per repeat
+					if (ev.button == BUTTON_UP) {
+						if (pwm_percentage < 100) {
+							pwm_percentage++;
+						}
+					} else if (pwm_percentage > 0) {
+						pwm_percentage--;
+					}
+					break;
+				
+				case GESTURE_DOUBLE:
+					pwm_percentage = (ev.button == BUTTON_UP) ? 100 : 0;
+					break;
+			}
+			if (pwm_percentage > 100) {
+				pwm_percentage = 100;
+			} else if (pwm_percentage < 0) {
 				pwm_percentage = 0;
-			} else { // increment duty cycle by 10%
-				pwm_percentage += 10;
 			}
 			updateCCP2DutyCycle(pwm_percentage);
 		}
@@ -88,33 +180,22 @@ void updateCCP2DutyCycle(int pwm_percentage) {
 	 *   PWM Ratio = (CCPRXL:CCPXCON<5:4>) / [(PR2) + 1]  4]
 	 *   (CCPRXL:CCPXCON<5:4>) = Ratio * [(PR2) + 1]  4]
 	 */
-	// round off the float
-	int pwm_duty_cycle = round( (pwm_percentage * 0.01f) * (PWM_PERIOD + 1) * 4 ); 
-	CCP2CONbits.DC2B = 0b11 & pwm_duty_cycle; // DCxB<1:0>: bits 0, 1
-	CCPR2L = pwm_duty_cycle >> 2;
+	// Integer only, the ramp engine walks CCP2 to the new value
+	UINT16 pwm_duty_cycle = ((UINT32) pwm_percentage * PWM_getFullScale() + 50) / 100;
+	Ramp_setTarget(pwm_duty_cycle, RAMP_STEP, RAMP_TICKS, RAMP_LINEAR);
 }
 
 //----------------------------------------------------------------------------
-// High priority interrupt vector
+// Interrupt handlers, called from Irq-Lib.h
 
-#pragma code InterruptVectorHigh = 0x08
-void InterruptVectorHigh(void) {
-	_asm
-	goto ISR
-	_endasm
+void onButtonTick(void) {
+	Power_isr(); // Clears TMR1IF
+	Gesture_tick(buttons());
 }
 
-//----------------------------------------------------------------------------
-// High priority interrupt routine
-
-#pragma code
-#pragma interrupt ISR
-
-void ISR(void) {
-	if (INTCONbits.INT0IF) {
-		INTCONbits.INT0IF = 0;
-		RB0_Pressed = TRUE;
-	}
+void onRampTick(void) {
+	PIR1bits.TMR2IF = 0;
+	Ramp_tick(); // At a PWM period boundary
 }
 
 //----------------------------------------------------------------------------
@@ -0,0 +1,152 @@
+#ifndef DELAY_LIB_H
+#define DELAY_LIB_H
+
+#include <GenericTypeDefs.h>
+
+/* Cycle-exact delays, worked out from FOSC at compile time
+ *
+ * delay_us(N) and delay_ms(N) turn N into instruction cycles,
+ *   t = FOSC / 4 * N / 1000000, rounded
+ * and delay_tcy(t) runs Delay_run(), a loop written in assembly so that its
+ * cycle count is known from the instruction timings and not from whatever
+ * the compiler generates:
+ *   bit tests on delay_r    14 Tcy, + 1, 2, 4, 8 for bits 0-3 of delay_r
+ *   16-bit countdown        8 Tcy a turn, delay_hi:delay_lo + 1 turns,
+ *                           the last one 7 Tcy
+ *   call and return         2 + 2 Tcy
+ * so Delay_run() takes 25 + r + 8 * n Tcy. The three bytes are set from C
+ * just before the call, each a MOVLW/MOVWF (2 Tcy) or a CLRF/SETF for 0x00
+ * and 0xFF (1 Tcy). That cost is taken off t too, and what is left over
+ * from the 8 Tcy turns goes into r, so the whole delay_tcy(t) is t cycles.
+ * delay_r keeps bit 4 set so it is never 0x00 or 0xFF and always costs 2.
+ * N must be a constant, and t at least DELAY_MIN_TCY. An interrupt during
+ * a delay makes it longer by the ISR time.
+ *
+ * The operands live in the access bank and are not saved by an ISR, so
+ * delays are for main only.
+ *
+ * A delay longer than DELAY_MAX_US does not build: the CPU should not be
+ * stuck that long. Use a timestamp instead and carry on meanwhile:
+ *     DelayTime t = Delay_now();
+ *     ...
+ *     if (elapsed(t, 400)) { // 400ms since t
+ * Delay_setupTimer() runs Timer0 free at Tcy / 256 for this, with no
+ * interrupt. elapsed() compares a 16-bit difference, so the wait must be
+ * shorter than one Timer0 wrap (65536 * 256 Tcy: 6.7s at 10MHz, 1.6s at
+ * 40MHz) and be checked at least once per wrap.
+ *
+ * FOSC (in Hz, as an integer) must be defined before including this file.
+ */
+
+#ifndef FOSC
+#error "FOSC must be defined before including Delay-Lib.h"
+#endif
+#ifndef DELAY_MAX_US
+#define DELAY_MAX_US (50000UL) // 50ms
+#endif
+
+#define DELAY_US_TCY(us) ((FOSC / 4000 * (us) + 500) / 1000)
+
+/* t = stores + DELAY_RUN_TCY + r + 8 * n, see above */
+#define DELAY_RUN_TCY (25)
+#define DELAY_MIN_TCY (DELAY_RUN_TCY + 6)
+#define DELAY_STORE_TCY(v) (((v) & 0xFF) == 0 || ((v) & 0xFF) == 0xFF ? 1 : 2)
+#define DELAY_N(t) (((t) - DELAY_MIN_TCY) / 8)
+#define DELAY_STORES(t) (2 + DELAY_STORE_TCY(DELAY_N(t)) + DELAY_STORE_TCY(DELAY_N(t) >> 8))
+#define DELAY_R(t) ((t) - DELAY_RUN_TCY - DELAY_STORES(t) - 8 * DELAY_N(t)) // 0 to 9
+
+#define delay_tcy(t) do { \
+    typedef char delay_out_of_range[(t) >= DELAY_MIN_TCY && DELAY_N(t) <= 65535 ? 1 : -1]; \
+    delay_r = DELAY_R(t) | 0x10; \
+    delay_lo = DELAY_N(t) & 0xFF; \
+    delay_hi = DELAY_N(t) >> 8; \
+    Delay_run(); \
+} while (0)
+
+#define delay_us(us) do { \
+    typedef char delay_use_elapsed[(us) <= DELAY_MAX_US ? 1 : -1]; \
+    delay_tcy(DELAY_US_TCY(us)); \
+} while (0)
+#define delay_ms(ms) delay_us((ms) * 1000UL)
+
+#pragma udata access delay_access
+near UINT8 delay_r; // Delay_run() operands, in the access bank
+near UINT8 delay_lo;
+near UINT8 delay_hi;
+#pragma udata
+
+/* Timestamps on Timer0 */
+typedef UINT16 DelayTime;
+
+#define DELAY_MS_TICKS(ms) ((UINT16) (FOSC / 4000 * (ms) / 256))
+#define elapsed(since, ms) ((UINT16) (Delay_now() - (since)) >= DELAY_MS_TICKS(ms))
+
+// Function prototype
+void Delay_run(void);
+void Delay_setupTimer(void);
+DelayTime Delay_now(void);
+
+
+void Delay_run(void) {
+    /* delay_r, delay_lo and delay_hi set by delay_tcy() */
+    _asm
+    btfsc delay_r, 0, 0 // Bit 0: 2 Tcy clear, 3 set
+    bra delay_b0
+delay_b0:
+    btfsc delay_r, 1, 0 // Bit 1: 4 Tcy clear, 6 set
+    bra delay_b1s
+    bra delay_b1
+delay_b1s:
+    nop
+    bra delay_b1
+delay_b1:
+    btfsc delay_r, 2, 0 // Bit 2: 4 Tcy clear, 8 set
+    bra delay_b2s
+    bra delay_b2
+delay_b2s:
+    nop
+    nop
+    nop
+    bra delay_b2
+delay_b2:
+    btfsc delay_r, 3, 0 // Bit 3: 4 Tcy clear, 12 set
+    bra delay_b3s
+    bra delay_b3
+delay_b3s:
+    nop
+    nop
+    nop
+    nop
+    nop
+    nop
+    nop
+    bra delay_b3
+delay_b3:
+delay_loop: // delay_hi:delay_lo - 1 until it borrows, 8 Tcy a turn
+    movlw 1
+    subwf delay_lo, 1, 0
+    movlw 0
+    subwfb delay_hi, 1, 0
+    nop
+    nop
+    bc delay_loop // 2 Tcy taken, 1 on the last turn
+    _endasm
+}
+
+void Delay_setupTimer(void) {
+    T0CONbits.TMR0ON = 0;
+    T0CONbits.T08BIT = 0; // 0 = 16-bit timer/counter
+    T0CONbits.T0CS = 0; // 0 = Internal instruction cycle clock
+    T0CONbits.PSA = 0; // 0 = Timer0 prescaler is assigned
+    T0CONbits.T0PS = 0b111; // 111 = 1:256 prescale value
+    TMR0H = 0;
+    TMR0L = 0;
+    T0CONbits.TMR0ON = 1; // 1 = Enables Timer0
+}
+
+DelayTime Delay_now(void) {
+    DelayTime t = TMR0L; // Latches TMR0H
+    return t | ((DelayTime) TMR0H << 8);
+}
+
+#endif
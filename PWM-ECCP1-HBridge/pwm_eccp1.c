@@ -0,0 +1,76 @@
+/*
+ * PICDEM 2 PLUS DEMO BOARD
+ * PIC18F4520
+ *
+ * Drive a motor H-bridge with the Enhanced CCP1 module.
+ * A 20kHz carrier is generated on P1A:P1D without any
+ * software toggling.
+ *
+ * Full-bridge mode (default):
+ *     Push button on RA4 reverses the motor direction.
+ * Half-bridge mode (#define HALF_BRIDGE):
+ *     P1A/P1B drive complementary outputs with dead-band.
+ *
+ * Push button on RB0/INT0 acts as the fault input. While it is
+ * held low, the ECCP auto-shutdown drives all outputs low. The
+ * outputs restart on their own once it is released.
+ *
+ * CCP2 on RC1 shares the same carrier (Timer2) and gives
+ * a 50% reference signal.
+ *
+ * The LCD on RD[4:7] must not be fitted, as RD5:7 are P1B:P1D.
+ *
+ * The clock is set to HSPLL with a 10MHz crystal (Fosc = 40MHz)
+ */
+
+#include <p18f4520.h>
+#include <GenericTypeDefs.h>
+#include <delays.h>
+
+#define FOSC (40000000UL) // 40MHz HSPLL mode
+#include "PWM-Lib.h"
+#include "Delay-Lib.h"
+
+// #define HALF_BRIDGE
+#define PWM_FREQ (20000) // 20kHz carrier
+#define PWM_DUTY_CYCLE (60) // Percentage of Duty Cycle
+#define DEAD_BAND_NS (500) // Half-bridge dead-band
+
+void main(void) {
+    BOOL forward = TRUE;
+
+    // RA4 button as input, RB0/INT0 fault input
+    ADCON1bits.PCFG = 0b1111; // All digital
+    TRISA |= 1<<4;
+    TRISBbits.TRISB0 = 1;
+
+    // Shared carrier for CCP1 and CCP2
+    PWM_setFrequency(PWM_FREQ);
+
+#ifdef HALF_BRIDGE
+    ECCP_setMode(ECCP_HALF_BRIDGE, ECCP_AC_HIGH_BD_HIGH);
+    ECCP_setDeadBand(DEAD_BAND_NS);
+#else
+    ECCP_setMode(ECCP_FULL_FORWARD, ECCP_AC_HIGH_BD_HIGH);
+#endif
+    PWM_setDutyCycle(PWM_CCP1, PWM_DUTY_CYCLE);
+
+    // Fault on INT0 drives every output low, restart automatically
+    ECCP_setAutoShutdown(ECCP_AS_INT0, ECCP_SHUTDOWN_LOW, ECCP_SHUTDOWN_LOW, TRUE);
+
+    PWM_setDutyCycle(PWM_CCP2, 50);
+
+    PWM_enable(PWM_CCP1);
+    PWM_enable(PWM_CCP2);
+
+    while (1) {
+#ifndef HALF_BRIDGE
+        if (PORTAbits.RA4 == 0) {
+            forward = !forward;
+            ECCP_setDirection(forward);
+            while (PORTAbits.RA4 == 0); // Wait for release
+            delay_ms(25); // Debounce
+        }
+#endif
+    }
+}
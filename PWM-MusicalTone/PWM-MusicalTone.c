@@ -15,6 +15,14 @@
  * to maintain the same duty cycle regardless of the
  * PWM period.
  *
+ * PR2 steps make some notes audibly off, so the note table
+ * keeps whichever PR2 around each note comes closer to it
+ * (Tone-Cal.h), worked out from FOSC at start-up.
+ *
+ * RB0 bounce is filtered in the ISR (Int0-Lib.h, Timer3):
+ * edges within 30ms are ignored and the next note needs the
+ * button released first, so no note is skipped.
+ *
  * The clock is set to HS with a 10MHz crystal (Fosc = 10MHz)
  */
 
@@ -37,20 +45,20 @@ float ToneFreq[] = {
 
 
 #define round(x) ((x) + 0.5)
-#define FOSC (10e6) // 10MHz HS mode
+#define FOSC (10000000UL) // 10MHz HS mode
 #define PWM_PRESCALE (16)
 #define PWM_DUTY_CYCLE (10) // Percentage of Duty Cycle
+#include "Tone-Cal.h"
 
-/* Calculation for Timer 0 as 1 sec
- *   10MHz clock, 256 prescaler, 8 bit mode
- *   Instruction freq = 10MHz / 4 = 2.5MHz
- *   Timer clock freq = 2.5MHz / 256 prescaler
- *   No of cycles = 1Hz / (2.5MHz / 256)^-1
- *   No of cycles = 2.5e6 / 256 = 9765.625
- *   Reset value = 65535 - 9765.625 = 55769.375
- *   Formula: 65535 - FOSC / 4 / PRESCALE 
- */ 
-#define TIMER0_RESET_VAL (55769)
+/* Timer 0 as 1 sec (Timer0-Lib.h)
+ *   10MHz clock -> 2.5e6 Tcy = 9632 + 38 * 65536
+ *   Reload and wrap count are worked out from FOSC at compile time
+ */
+#define TIMER0_PERIOD_US (1000000UL)
+#include "Timer0-Lib.h"
+
+#define INT0_CONFIRM_RELEASE
+#include "Int0-Lib.h"
 
 
 BOOL RB0_Pressed = FALSE;
@@ -59,26 +67,18 @@ void main(void);
 void setPWMFrequency(float freq);
 void setPWMDutyCycleCCP2(int pwm_percentage);
 void ISR(void);
-void resetTimer0OneSecond();
 
 void main(void) {
     int array_index = 0;
-    float freq;
     
     // Set up Timer 0
     INTCONbits.PEIE = 1; // enable peripheral interrupt
     INTCON2bits.TMR0IP = 1; // TMR0 high priority
-    INTCONbits.TMR0IE = 1; // TMR0 interrupt enable
-    T0CONbits.PSA = 0; // Assign prescaler
-    T0CONbits.T0PS = 0b111; // Prescaler 1:256
-    T0CONbits.T0CS = 0; // internal clock source
-    T0CONbits.T08BIT = 0; // 0 = Timer0 is configured as a 16-bit timer/counter 
-    T0CONbits.TMR0ON = 1; // Enable Timer 0
+    Timer0_setupPeriodic(); // 16-bit, 1:1, TMR0 interrupt enable
     
     // Set up external interrupt -> RB0 push button 
     TRISB = 1<<0; // RB0 as input
-    INTCONbits.INT0IE = 1; // INT0 enabled  
-    INTCON2bits.INTEDG0 = 0; // Interrupt on falling edge
+    Int0_setup(); // Falling edge, INT0 enabled
     INTCONbits.GIEH = 1; // Enable global interrupts
     
     /****************************************************
@@ -111,16 +111,18 @@ void main(void) {
     // 5. Configure the CCPx module for PWM operation.
     CCP2CONbits.CCP2M = 0b1100; // CCP2 as PWM mode -> 11xx = PWM mode
     
+    // 6. Nearest PR2 for each note
+    Tone_setup(ToneFreq);
+    Tone_play(0);
+    
     while (1) {
         if (RB0_Pressed) {
-            freq = ToneFreq[++array_index];
-            if (freq == -1) { // reset to first freq
+            if (++array_index >= tone_count) { // reset to first note
                 array_index = 0;
-                freq = ToneFreq[array_index];
             }
-            setPWMFrequency(freq);
+            Tone_play(array_index);
             setPWMDutyCycleCCP2(PWM_DUTY_CYCLE);
-            resetTimer0OneSecond();
+            Timer0_restart(); // Note lasts one second from now
             RB0_Pressed = FALSE;
         }
     }
@@ -176,24 +178,20 @@ void InterruptVectorHigh(void) {
 // High priority interrupt routine
 
 #pragma code
-#pragma interrupt ISR
+#pragma interrupt ISR save=PROD,section(".tmpdata"),section("MATH_DATA")
 
 void ISR(void) {
     if (INTCONbits.INT0IF) {
-        INTCONbits.INT0IF = 0;
-        RB0_Pressed = TRUE;
+        if (Int0_isr()) {
+            RB0_Pressed = TRUE;
+        }
     }
     
     if (INTCONbits.TMR0IF) {
-        INTCONbits.TMR0IF = 0;
-        setPWMDutyCycleCCP2(0);
+        if (Timer0_isr()) { // Once per second
+            setPWMDutyCycleCCP2(0);
+        }
     }
 }
 
-void resetTimer0OneSecond() {
-    
-    TMR0H = TIMER0_RESET_VAL >> 8; //reset timer
-    TMR0L = TIMER0_RESET_VAL & 0xFF; //reset timer
-}
-
 //----------------------------------------------------------------------------
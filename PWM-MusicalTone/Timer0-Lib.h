@@ -0,0 +1,146 @@
+#ifndef TIMER0_LIB_H
+#define TIMER0_LIB_H
+
+#include <GenericTypeDefs.h>
+
+/* Drift-free periodic Timer0 interrupt
+ *
+ * Writing a fixed reload value in the ISR loses the counts that happen
+ * between the overflow and the write, which depends on interrupt latency,
+ * so the period drifts. Here the reload is added to what Timer0 has
+ * already counted instead, so latency does not matter.
+ *
+ * Timer0 runs 16-bit at 1:1. The prescaler is not used, because every write
+ * to TMR0 clears it and the lost part of a prescaler count can not be known.
+ * A period longer than 65536 Tcy is made of one short count plus a number of
+ * full 65536 Tcy wraps, counted in the ISR:
+ *   TIMER0_PERIOD_TCY = FOSC / 4 * TIMER0_PERIOD_US / 1000000
+ *                     = (65536 - TIMER0_RELOAD) + TIMER0_WRAPS * 65536
+ *   e.g. 100ms at 10MHz = 250000 Tcy = 53392 + 3 * 65536
+ * Everything is worked out at compile time from FOSC and TIMER0_PERIOD_US.
+ * The ISR must run within the short count (65536 - TIMER0_RELOAD Tcy) of
+ * the overflow that starts a period.
+ *
+ * The read-add-write loses a fixed number of counts, TIMER0_ADD_TCY, which
+ * is added to the reload. So that it does not depend on the compiler, the
+ * add in Timer0_add() is inline assembly on access bank bytes, all single
+ * cycle instructions:
+ *   movf   timer0_add_l      ; W = x low
+ *   addwf  TMR0L, W          ; read TMR0L (latches TMR0H), W = low sum
+ *   movwf  timer0_add_tmp
+ *   movf   timer0_add_h      ; W = x high
+ *   addwfc TMR0H, W          ; latched high byte + carry
+ *   movwf  TMR0H             ; buffered until TMR0L is written
+ *   movf   timer0_add_tmp
+ *   movwf  TMR0L             ; write, TMR0H goes in with it
+ * TMR0L is read by the 2nd instruction and written by the 8th: Timer0
+ * would have counted 6 in between, and does not count for 2 Tcy after a
+ * write (datasheet, Timer0 module), so TIMER0_ADD_TCY = 6 + 2 = 8.
+ *
+ * After a clock change, Timer0_retime() (a Clock-Lib.h callback) works the
+ * reload and wrap count out again at run time for the same period.
+ *
+ * FOSC (in Hz, as an integer) and TIMER0_PERIOD_US must be defined before
+ * including this file.
+ */
+
+#ifndef FOSC
+#error "FOSC must be defined before including Timer0-Lib.h"
+#endif
+#ifndef TIMER0_PERIOD_US
+#error "TIMER0_PERIOD_US must be defined before including Timer0-Lib.h"
+#endif
+#define TIMER0_ADD_TCY (8) // See Timer0_add()
+
+#define TIMER0_PERIOD_TCY (FOSC / 4000 * (TIMER0_PERIOD_US / 1000) + FOSC / 4000 * (TIMER0_PERIOD_US % 1000) / 1000)
+#if TIMER0_PERIOD_TCY < 256
+#error "TIMER0_PERIOD_US too short for Timer0"
+#endif
+#define TIMER0_WRAPS ((TIMER0_PERIOD_TCY - 1) / 65536)
+#define TIMER0_RELOAD (65536 - (TIMER0_PERIOD_TCY - TIMER0_WRAPS * 65536))
+
+volatile UINT16 timer0_wraps = 0; // Full wraps left in this period
+UINT16 timer0_reload = TIMER0_RELOAD;
+UINT16 timer0_wrap_count = TIMER0_WRAPS;
+
+#pragma udata access timer0_access
+near UINT8 timer0_add_l; // Timer0_add() operands, in the access bank
+near UINT8 timer0_add_h;
+near UINT8 timer0_add_tmp;
+#pragma udata
+
+// Function prototype
+void Timer0_setupPeriodic(void);
+void Timer0_restart(void);
+void Timer0_retime(UINT32 fosc);
+void Timer0_add(UINT16 x);
+BOOL Timer0_isr(void);
+
+
+void Timer0_setupPeriodic(void) {
+    T0CONbits.TMR0ON = 0;
+    T0CONbits.T08BIT = 0; // 0 = 16-bit timer/counter
+    T0CONbits.T0CS = 0; // 0 = Internal instruction cycle clock
+    T0CONbits.PSA = 1; // 1 = Timer0 prescaler is not assigned
+    Timer0_restart();
+    INTCONbits.TMR0IF = 0;
+    INTCONbits.TMR0IE = 1; // Enable Timer0 overflow interrupt
+    T0CONbits.TMR0ON = 1; // 1 = Enables Timer0
+}
+
+void Timer0_restart(void) {
+    /* Start a whole period from now */
+    UINT8 gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    TMR0H = timer0_reload >> 8; // Buffered until TMR0L is written
+    TMR0L = timer0_reload & 0xFF;
+    INTCONbits.TMR0IF = 0;
+    timer0_wraps = timer0_wrap_count;
+    INTCONbits.GIEH = gie;
+}
+
+void Timer0_retime(UINT32 fosc) {
+    /* Same period at a new clock, then start it from now */
+    UINT32 tcy = fosc / 4000 * (TIMER0_PERIOD_US / 1000)
+               + (fosc % 4000) * (TIMER0_PERIOD_US / 1000) / 4000
+               + fosc / 4000 * (TIMER0_PERIOD_US % 1000) / 1000;
+    if (tcy < 256) {
+        tcy = 256; // Too slow a clock for this period
+    }
+    timer0_wrap_count = (tcy - 1) >> 16;
+    timer0_reload = (UINT16) (0 - (UINT16) tcy); // 65536 - (tcy % 65536)
+    Timer0_restart();
+}
+
+void Timer0_add(UINT16 x) {
+    /* TMR0 += x, keeping what was counted since the overflow.
+     * TMR0L is read and written TIMER0_ADD_TCY - 2 cycles apart. From the
+     * ISR only, the operand bytes are not saved.
+     */
+    timer0_add_l = x & 0xFF;
+    timer0_add_h = x >> 8;
+    _asm
+    movf timer0_add_l, 0, 0
+    addwf TMR0L, 0, 0
+    movwf timer0_add_tmp, 0
+    movf timer0_add_h, 0, 0
+    addwfc TMR0H, 0, 0
+    movwf TMR0H, 0
+    movf timer0_add_tmp, 0, 0
+    movwf TMR0L, 0
+    _endasm
+}
+
+BOOL Timer0_isr(void) {
+    /* Call from the ISR when TMR0IF is set, TRUE once per period */
+    INTCONbits.TMR0IF = 0; //clear interrupt flag
+    if (timer0_wraps != 0) {
+        timer0_wraps--;
+        return FALSE;
+    }
+    Timer0_add(timer0_reload + TIMER0_ADD_TCY);
+    timer0_wraps = timer0_wrap_count;
+    return TRUE;
+}
+
+#endif
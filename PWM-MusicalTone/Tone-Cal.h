@@ -0,0 +1,91 @@
+#ifndef TONE_CAL_H
+#define TONE_CAL_H
+
+#include <GenericTypeDefs.h>
+
+/* Nearest PR2 for each note of the PWM note table
+ *
+ * PR2 can only take whole values, so at 10MHz with a 1:16 prescaler the
+ * notes land up to half a PR2 step (~0.3%, 6 cents at C6) away from the
+ * wanted frequency, and which neighbour is closer is not always the
+ * rounded one, as the frequency goes with 1 / (PR2 + 1). Tone_setup()
+ * works out the frequency of both PR2 values around each note,
+ *   f = FOSC / 4 / PWM_PRESCALE / (PR2 + 1)
+ * and keeps the closer one. The prescaler is fixed at 1:16: with 1:4 every
+ * note here would need PR2 above 255.
+ *
+ * The PWM and any capture of it both run from Tcy, so measuring the output
+ * on the same chip only gives this formula back and can not show a clock
+ * error. An independent reference would be the 32.768kHz Timer1 crystal,
+ * but its T1OSI pin is RC1, the CCP2 output driving the buzzer. So the
+ * table is worked out from FOSC, and the crystal error (tens of ppm, far
+ * below what can be heard) stays.
+ *
+ * FOSC and PWM_PRESCALE must be defined before including this file.
+ */
+
+#ifndef FOSC
+#error "FOSC must be defined before including Tone-Cal.h"
+#endif
+#ifndef PWM_PRESCALE
+#error "PWM_PRESCALE must be defined before including Tone-Cal.h"
+#endif
+#ifndef TONE_MAX
+#define TONE_MAX (16)
+#endif
+
+UINT8 tone_pr2[TONE_MAX]; // Nearest PR2 per note
+float tone_actual[TONE_MAX]; // Frequency played with it
+UINT8 tone_count = 0;
+
+// Function prototype
+UINT8 Tone_nominalPR2(float freq);
+float Tone_freq(UINT8 pr2);
+void Tone_setup(float *freq);
+void Tone_play(UINT8 index);
+
+
+UINT8 Tone_nominalPR2(float freq) {
+    /* PR2 = 0.25 * FOSC / freq / prescale - 1, rounded down */
+    float pr2 = 0.25 * FOSC / freq / PWM_PRESCALE - 1;
+    if (pr2 < 0) {
+        return 0;
+    }
+    if (pr2 > 255) {
+        return 255;
+    }
+    return (UINT8) pr2;
+}
+
+float Tone_freq(UINT8 pr2) {
+    return 0.25 * FOSC / PWM_PRESCALE / ((UINT16) pr2 + 1);
+}
+
+void Tone_setup(float *freq) {
+    /* freq: wanted frequencies, ended by -1 */
+    UINT8 i, pr2;
+    float f0, f1, e0, e1;
+
+    for (i = 0; i < TONE_MAX && freq[i] != -1; i++) {
+        pr2 = Tone_nominalPR2(freq[i]);
+        f0 = Tone_freq(pr2); // At or above freq
+        tone_pr2[i] = pr2;
+        tone_actual[i] = f0;
+        if (pr2 < 255) {
+            f1 = Tone_freq(pr2 + 1); // Next step down
+            e0 = (f0 > freq[i]) ? f0 - freq[i] : freq[i] - f0;
+            e1 = (f1 > freq[i]) ? f1 - freq[i] : freq[i] - f1;
+            if (e1 < e0) {
+                tone_pr2[i] = pr2 + 1;
+                tone_actual[i] = f1;
+            }
+        }
+    }
+    tone_count = i;
+}
+
+void Tone_play(UINT8 index) {
+    PR2 = tone_pr2[index];
+}
+
+#endif
@@ -6,16 +6,46 @@
  * Push button on RB0 will trigger an interrupt 
  * and increment a counter. The binary value is
  * shown with LEDs on RA0:7
+ *
+ * Between presses the CPU sleeps (Power-Lib.h), woken by INT0
+ * or by the Timer1 crystal every 2s. Time asleep and wake
+ * latency are kept in `power` for the watch window.
+ *
+ * Button bounce is filtered in the ISR (Int0-Lib.h): edges
+ * within 30ms are ignored, timed on the Timer1 crystal as it
+ * keeps running in sleep, and a press only counts once the
+ * last one has been released.
+ *
+ * Presses are counted in the ISR (Ring-Lib.h), not flagged,
+ * so main adds them all even if it falls behind. The ISR also
+ * queues the time of each press (Ring16), and main keeps the
+ * time between the last two in `press_gap_ms` for the watch
+ * window, up to 64s.
  */
 
 #include <p18f4520.h>
 #include <GenericTypeDefs.h>
+#include "Power-Lib.h"
 
-BOOL RB0_Pressed = FALSE;
+#define INT0_POWER_TIME
+#define INT0_CONFIRM_RELEASE
+#include "Int0-Lib.h"
+#include "Ring-Lib.h"
+
+#define PRESS_TIMES (8) // Queued press times, a power of 2
+#define PRESS_TIME_SHIFT (5) // Power-Lib ticks / 32: ~1ms at 32768Hz
+
+EventCount presses;
+UINT16 press_buf[PRESS_TIMES];
+Ring16 press_times;
+UINT16 press_gap_ms = 0;
+PowerStats power;
 void ISR(void);
 
 void main(void) {
     UINT8 count = 0;
+    UINT16 stamp, last_stamp = 0;
+    BOOL stamped = FALSE;
     
     // RB0 as input
     TRISB = 1<<0;
@@ -23,19 +53,40 @@ void main(void) {
     // RA0:7 as output
     TRISA = 0;
     
+    LATA = count;
+    
+    // Timer1 time base for the sleep statistics
+    Power_setup();
+    Count_init(&presses);
+    Ring16_init(&press_times, press_buf, PRESS_TIMES);
+    
     // Setup push button interrupt
+    Int0_setup();
     INTCONbits.GIEH = 1; // Enable global interrupt
-    INTCONbits.INT0IE = 1; // INT0 enabled
-    INTCON2bits.INTEDG0 = 0; // Interrupt on falling edge
     
     while (1) {
-        if (RB0_Pressed) {
-            RB0_Pressed = FALSE;
-            //Increment LED counter
-            count++;
+        // Sleep until the next press, checked with interrupts off
+        INTCONbits.GIEH = 0;
+        if (!Count_pending(&presses)) {
+            Power_idle(POWER_SLEEP);
+        }
+        INTCONbits.GIEH = 1; // INT0 or Timer1 ISR runs here
+        
+        if (Count_pending(&presses)) {
+            //Increment LED counter by every press since the last time
+            count += Count_take(&presses);
+            // Update LEDs
+            LATA = count;
+            Power_read(&power);
+        }
+        while (Ring16_get(&press_times, &stamp)) {
+            if (stamped) {
+                press_gap_ms = (UINT32) (UINT16) (stamp - last_stamp)
+                             * (1000UL << PRESS_TIME_SHIFT) / POWER_TICK_HZ;
+            }
+            last_stamp = stamp;
+            stamped = TRUE;
         }
-        // Update LEDs
-        LATA = count;
     }
 }
 
@@ -47,10 +98,15 @@ void InterruptVectorHigh(void) {
     _endasm
 }
 #pragma code
-#pragma interrupt ISR
+#pragma interrupt ISR save=PROD,section(".tmpdata"),section("MATH_DATA")
 void ISR(void) {
     if (INTCONbits.INT0IF == 1) {
-        INTCONbits.INT0IF = 0;
-        RB0_Pressed = TRUE;
+        if (Int0_isr()) {
+            Count_post(&presses);
+            Ring16_put(&press_times, (UINT16) (int0_stamp >> PRESS_TIME_SHIFT));
+        }
+    }
+    if (PIR1bits.TMR1IF) {
+        Power_isr();
     }
 }
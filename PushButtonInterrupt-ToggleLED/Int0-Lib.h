@@ -0,0 +1,153 @@
+#ifndef INT0_LIB_H
+#define INT0_LIB_H
+
+#include <GenericTypeDefs.h>
+
+/* Push button on RB0/INT0 without contact bounce
+ *
+ * A button bounces for a few ms, and INT0 sees every bounce as a falling
+ * edge. Int0_isr() is called from the ISR on INT0IF and keeps the press at
+ * interrupt latency, but ignores any edge within INT0_LOCKOUT_MS of the
+ * last one it took. It gives TRUE for a press, once.
+ *
+ * With INT0_CONFIRM_RELEASE, a new press only counts once the release has
+ * been seen (and its own bounce has passed too), so a button held down can
+ * never count twice, however long it bounces. INTEDG0 is not toggled blindly
+ * but set from the pin after every edge, taken or ignored: pin low (held)
+ * waits for the rising edge, pin high waits for the next press. A tap
+ * shorter than the lockout has its release ignored, but the pin is high by
+ * then, so the next press still counts.
+ *
+ * Edges are timed against a free-running timer:
+ *   default           Timer3 at Tcy / 8, restarted on each edge taken. The
+ *                     lockout must fit 16 bits (52ms at 10MHz, 13ms at 40MHz)
+ *   INT0_POWER_TIME   Power_now() of Power-Lib.h, which keeps counting in
+ *                     sleep, so the button can wake the CPU
+ * Edges ignored are counted in int0_glitches, to tune the lockout.
+ *
+ * RB0 must be an input (TRISB) before Int0_setup(). FOSC (in Hz, as an
+ * integer) must be defined before including this file, unless
+ * INT0_POWER_TIME is used.
+ */
+
+#ifndef INT0_LOCKOUT_MS
+#define INT0_LOCKOUT_MS (30)
+#endif
+
+#ifdef INT0_POWER_TIME
+#ifndef POWER_LIB_H
+#error "Power-Lib.h must be included before Int0-Lib.h with INT0_POWER_TIME"
+#endif
+#define INT0_LOCKOUT_TICKS (POWER_TICK_HZ * INT0_LOCKOUT_MS / 1000)
+#else
+#ifndef FOSC
+#error "FOSC must be defined before including Int0-Lib.h"
+#endif
+#define INT0_LOCKOUT_TICKS (FOSC / 32000 * INT0_LOCKOUT_MS) // Tcy / 8
+#if INT0_LOCKOUT_TICKS > 65535
+#error "INT0_LOCKOUT_MS is too long for Timer3 at this FOSC"
+#endif
+#endif
+
+volatile UINT8 int0_presses = 0; // Presses taken, wraps
+UINT16 int0_glitches = 0; // Edges ignored
+#ifdef INT0_POWER_TIME
+UINT32 int0_stamp = 0; // Power_now() at the last edge taken
+#endif
+
+// Function prototype
+void Int0_setup(void);
+BOOL Int0_isr(void);
+UINT32 Int0_elapsed(void);
+void Int0_stamp(void);
+void Int0_follow(void);
+
+
+void Int0_setup(void) {
+#ifndef INT0_POWER_TIME
+    T3CONbits.TMR3ON = 0;
+    T3CONbits.RD16 = 1; // 16-bit read/write
+    T3CONbits.TMR3CS = 0; // Internal clock (FOSC/4)
+    T3CONbits.T3CKPS = 0b11; // 11 = 1:8 prescale value
+    PIE2bits.TMR3IE = 0; // Overflow is polled, no interrupt
+    T3CONbits.TMR3ON = 1;
+#endif
+    Int0_stamp();
+#ifdef INT0_POWER_TIME
+    int0_stamp -= INT0_LOCKOUT_TICKS; // The first edge is taken straight away
+#else
+    PIR2bits.TMR3IF = 1; // The first edge is taken straight away
+#endif
+    int0_presses = 0;
+    int0_glitches = 0;
+
+#ifdef INT0_CONFIRM_RELEASE
+    Int0_follow(); // Held at setup: wait for release
+#else
+    INTCON2bits.INTEDG0 = 0; // Interrupt on falling edge
+#endif
+    INTCONbits.INT0IF = 0;
+    INTCONbits.INT0IE = 1; // INT0 enabled
+}
+
+void Int0_follow(void) {
+    /* INTEDG0 from the pin as it is now: low (held) waits for the release,
+     * high waits for a press
+     */
+    UINT8 pin = PORTBbits.RB0;
+    INTCON2bits.INTEDG0 = !pin;
+    INTCONbits.INT0IF = 0; // Changing the edge can set the flag
+    if (PORTBbits.RB0 != pin) {
+        INTCONbits.INT0IF = 1; // Moved meanwhile, look again
+    }
+}
+
+UINT32 Int0_elapsed(void) {
+    /* Timer ticks since the last edge taken */
+#ifdef INT0_POWER_TIME
+    return Power_now() - int0_stamp;
+#else
+    UINT16 t;
+    if (PIR2bits.TMR3IF) {
+        return 0x10000UL; // Wrapped, so at least this
+    }
+    t = TMR3L; // Latches TMR3H
+    return t | ((UINT16) TMR3H << 8);
+#endif
+}
+
+void Int0_stamp(void) {
+#ifdef INT0_POWER_TIME
+    int0_stamp = Power_now();
+#else
+    TMR3H = 0; // Buffered until TMR3L is written
+    TMR3L = 0;
+    PIR2bits.TMR3IF = 0;
+#endif
+}
+
+BOOL Int0_isr(void) {
+    /* Call from the ISR when INT0IF is set. TRUE for a press */
+    INTCONbits.INT0IF = 0;
+    if (Int0_elapsed() < INT0_LOCKOUT_TICKS) {
+        int0_glitches++; // Bounce
+#ifdef INT0_CONFIRM_RELEASE
+        Int0_follow(); // A short tap's release may be this one
+#endif
+        return FALSE;
+    }
+    Int0_stamp();
+
+#ifdef INT0_CONFIRM_RELEASE
+    if (INTCON2bits.INTEDG0) {
+        // Release edge: wait for the next press, or still held
+        Int0_follow();
+        return FALSE;
+    }
+    Int0_follow(); // Wait for the release, or the next press if already let go
+#endif
+    int0_presses++;
+    return TRUE;
+}
+
+#endif
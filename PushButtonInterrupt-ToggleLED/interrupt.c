@@ -4,44 +4,44 @@
  * 
  * External Interrupts
  * A push button on RB0 will trigger an external 
- * interrupt to toggle an LED on RB1.
+ * interrupt to toggle an LED on RB1. Edges within
+ * 30ms of a press are button bounce and ignored
+ * (Int0-Lib.h), so each press toggles it once.
+ *
+ * The main loop stands for a long program with a 50ms
+ * delay (Delay-Lib.h), blinking RB2 each time round.
  */
 
 #include <p18f4520.h>
 #include <GenericTypeDefs.h>
+
+#define FOSC (10000000UL) // 10MHz HS mode
+#include "Delay-Lib.h"
+#include "Int0-Lib.h"
  
 BOOL RB0_Pressed = FALSE;
 
 void ISR(void);
-void delay(void);
 
 void main(void) {
 	// RB0 as input, RB1:3 as output 
 	TRISB = 0x01;
 	LATB = 0;  
 	
-	// Setup External interrupt 0 -> RB0 / INT0
+	// Setup External interrupt 0 -> RB0 / INT0, falling edge
+	Int0_setup();
 	INTCONbits.GIEH = 1; // Enable global interrupt
-	INTCONbits.INT0IE = 1; // INT0 enabled	
-	INTCON2bits.INTEDG0 = 0; // Interrupt on falling edge
 	
 	while (1) {
 		if (RB0_Pressed) {
 			RB0_Pressed = FALSE;
 			LATB ^= 1<<1; // Toggle on RB1 LED
 		}
-		delay(); /* Long program */
+		delay_ms(50); /* Long program */
 		LATB ^= 1<<2;
 	}
 }
 
-void delay() {
-	UINT16 i;
-	for (i = 0; i < 10000; i++) {
-		Nop();
-	}
-}
-
 #pragma code InterruptVectorHigh = 0x08 
 void InterruptVectorHigh(void) {
 	_asm
@@ -49,11 +49,12 @@ void InterruptVectorHigh(void) {
 	_endasm
 }
 #pragma code
-#pragma interrupt ISR
+#pragma interrupt ISR save=section(".tmpdata")
 void ISR(void) {
 	if (INTCONbits.INT0IF == 1) {
-		INTCONbits.INT0IF = 0;
-		RB0_Pressed = TRUE;
+		if (Int0_isr()) {
+			RB0_Pressed = TRUE;
+		}
 	}
 }
 
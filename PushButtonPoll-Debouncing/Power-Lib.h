@@ -0,0 +1,203 @@
+#ifndef POWER_LIB_H
+#define POWER_LIB_H
+
+#include <GenericTypeDefs.h>
+
+/* Idle and sleep instead of spinning in the main loop
+ *
+ * Power_idle() stops the CPU until an enabled interrupt source fires:
+ *   POWER_IDLE   IDLEN = 1, the CPU stops but the peripherals keep their
+ *                clock (PWM, Timer2/3, triggered A/D, ...)
+ *   POWER_SLEEP  IDLEN = 0, the oscillator stops too, only INT0-2, RB
+ *                change, the Timer1 oscillator and the like wake the CPU,
+ *                and the primary oscillator has to start again (OST, PLL)
+ *
+ * It must be called with GIEH = 0, after checking that there is nothing to
+ * do. An interrupt flag still wakes the CPU with GIEH = 0, it just carries
+ * on after SLEEP instead of going to the vector. The ISR runs when the
+ * caller sets GIEH again, so an event can not slip in between the check and
+ * the SLEEP instruction:
+ *     INTCONbits.GIEH = 0;
+ *     if (!event) {
+ *         Power_idle(POWER_SLEEP);
+ *     }
+ *     INTCONbits.GIEH = 1; // The ISR runs here
+ *
+ * Timer1 belongs to this file and keeps the time in ticks of POWER_TICK_HZ:
+ *   default          32.768kHz crystal on RC0/RC1, asynchronous, so it
+ *                    counts through sleep too (30.5us per tick)
+ *   POWER_CLOCK_TCY  FOSC/4, for boards where RC1 is taken (CCP2 output).
+ *                    Timer1 stops in sleep, so POWER_IDLE is always used
+ * The Timer1 interrupt fires every POWER_WAKE_TICKS (a multiple of 256, at
+ * most 65536) by adding to TMR1H, so it doubles as a periodic wake-up for
+ * polling inputs that have no interrupt. Power_isr() must be called from
+ * the ISR on TMR1IF.
+ *
+ * Power_read() gives the time spent asleep against the total since
+ * Power_clear(), and the wake latency: the ticks from a Timer1 overflow to
+ * the CPU running again after it, which is the only wake-up whose time is
+ * known. In IDLE this is under one crystal tick; from SLEEP it shows the
+ * oscillator start-up (1024 Tosc OST for HS, 2ms more with the PLL).
+ *
+ * FOSC (in Hz, as an integer) must be defined before including this file
+ * when POWER_CLOCK_TCY is used.
+ */
+
+#define POWER_SLEEP (0) // IDLEN = 0
+#define POWER_IDLE  (1) // IDLEN = 1
+
+#ifdef POWER_CLOCK_TCY
+#ifndef FOSC
+#error "FOSC must be defined before including Power-Lib.h with POWER_CLOCK_TCY"
+#endif
+#define POWER_TICK_HZ (FOSC / 4)
+#else
+#define POWER_TICK_HZ (32768UL)
+#endif
+#ifndef POWER_WAKE_TICKS
+#define POWER_WAKE_TICKS (65536UL) // Timer1 free-running
+#endif
+#if POWER_WAKE_TICKS < 256 || POWER_WAKE_TICKS > 65536 || POWER_WAKE_TICKS % 256 != 0
+#error "POWER_WAKE_TICKS must be a multiple of 256, from 256 to 65536"
+#endif
+#define POWER_RELOAD ((UINT16) (65536UL - POWER_WAKE_TICKS)) // TMR1 after the ISR
+#define POWER_T1H_ADD ((UINT8) (POWER_RELOAD >> 8))
+
+typedef struct {
+    UINT32 total; // Ticks since Power_clear()
+    UINT32 asleep; // Ticks spent in Power_idle()
+    UINT16 permille; // asleep / total
+    UINT16 wakes; // Power_idle() calls that slept
+    UINT32 wake_us; // Last Timer1 wake latency
+    UINT32 wake_max_us;
+} PowerStats;
+
+volatile UINT32 power_periods = 0; // Timer1 wake periods
+UINT32 power_start = 0;
+UINT32 power_asleep = 0;
+UINT16 power_wakes = 0;
+UINT16 power_wake_last = 0; // Ticks
+UINT16 power_wake_max = 0;
+
+// Function prototype
+void Power_setup(void);
+UINT16 Power_readTimer1(void);
+UINT32 Power_now(void);
+void Power_idle(UINT8 mode);
+void Power_isr(void);
+void Power_clear(void);
+void Power_read(PowerStats *s);
+UINT32 Power_ticksToUs(UINT16 t);
+
+
+void Power_setup(void) {
+    T1CONbits.TMR1ON = 0;
+    T1CONbits.RD16 = 0; // 8-bit writes, so TMR1H can be added to on its own
+    T1CONbits.T1CKPS = 0b00; // 1:1
+#ifdef POWER_CLOCK_TCY
+    T1CONbits.T1OSCEN = 0; // 0 = Timer1 oscillator is shut off
+    T1CONbits.TMR1CS = 0; // 0 = Internal clock (FOSC/4)
+#else
+    T1CONbits.T1OSCEN = 1; // 1 = Timer1 oscillator is enabled
+    T1CONbits.NOT_T1SYNC = 1; // 1 = Do not synchronize, keeps counting in sleep
+    T1CONbits.TMR1CS = 1; // 1 = External clock from the Timer1 oscillator
+#endif
+    TMR1H = POWER_T1H_ADD;
+    TMR1L = 0;
+    PIR1bits.TMR1IF = 0;
+    PIE1bits.TMR1IE = 1; // Enable Timer1 overflow interrupt
+    INTCONbits.PEIE = 1; // Enable peripheral interrupts
+    T1CONbits.TMR1ON = 1; // 1 = Enables Timer1
+    Power_clear();
+}
+
+UINT16 Power_readTimer1(void) {
+    UINT8 h, l;
+    do {
+        h = TMR1H;
+        l = TMR1L;
+    } while (h != TMR1H); // TMR1L rolled over in between
+    return ((UINT16) h << 8) | l;
+}
+
+UINT32 Power_now(void) {
+    /* Ticks since Power_setup(), from main or the ISR */
+    UINT8 gie = INTCONbits.GIEH;
+    UINT16 t;
+    UINT32 n;
+    INTCONbits.GIEH = 0;
+    t = Power_readTimer1();
+    n = power_periods;
+    if (PIR1bits.TMR1IF && !(t & 0x8000)) {
+        n = (n + 1) * POWER_WAKE_TICKS + t; // Overflow not counted yet
+    } else {
+        n = n * POWER_WAKE_TICKS + (UINT16) (t - POWER_RELOAD);
+    }
+    INTCONbits.GIEH = gie;
+    return n;
+}
+
+void Power_idle(UINT8 mode) {
+    /* Call with GIEH = 0 when there is nothing to do, see above */
+    UINT32 before;
+
+    if (PIR1bits.TMR1IF) {
+        return; // Would wake straight away, let the ISR count it first
+    }
+#ifdef POWER_CLOCK_TCY
+    mode = POWER_IDLE; // Timer1 stops in sleep
+#endif
+    before = Power_now();
+    OSCCONbits.IDLEN = mode;
+    Sleep();
+    if (PIR1bits.TMR1IF) {
+        // Woken by the overflow, TMR1 has counted from 0 since
+        power_wake_last = Power_readTimer1();
+        if (power_wake_last > power_wake_max) {
+            power_wake_max = power_wake_last;
+        }
+    }
+    power_asleep += Power_now() - before;
+    power_wakes++;
+}
+
+void Power_isr(void) {
+    /* Call from the ISR when TMR1IF is set */
+#if POWER_WAKE_TICKS < 65536
+    TMR1H += POWER_T1H_ADD; // Next overflow POWER_WAKE_TICKS after the last
+#endif
+    PIR1bits.TMR1IF = 0;
+    power_periods++;
+}
+
+void Power_clear(void) {
+    power_start = Power_now();
+    power_asleep = 0;
+    power_wakes = 0;
+    power_wake_last = 0;
+    power_wake_max = 0;
+}
+
+void Power_read(PowerStats *s) {
+    UINT32 total, asleep;
+    s->total = Power_now() - power_start;
+    s->asleep = power_asleep;
+    s->wakes = power_wakes;
+    s->wake_us = Power_ticksToUs(power_wake_last);
+    s->wake_max_us = Power_ticksToUs(power_wake_max);
+
+    // Scale down so asleep * 1000 fits in 32 bits
+    total = s->total;
+    asleep = s->asleep;
+    while (total > 0x3FFFFFUL) {
+        total >>= 1;
+        asleep >>= 1;
+    }
+    s->permille = total ? (UINT16) (asleep * 1000 / total) : 0;
+}
+
+UINT32 Power_ticksToUs(UINT16 t) {
+    return (UINT32) t * (1000000UL / 64) / (POWER_TICK_HZ / 64);
+}
+
+#endif
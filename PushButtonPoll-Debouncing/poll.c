@@ -4,36 +4,68 @@
  * 
  * Simple Button Debounced Polling 
  * Push button on RA4 will toggle the LEDs on RB0:3
+ *
+ * RA4 has no interrupt-on-change, so instead of spinning on
+ * it the CPU sleeps (Power-Lib.h) and the Timer1 crystal
+ * wakes it every 256 ticks (7.8ms). The ISR samples PORTA
+ * on each wake (Debounce-Lib.h), and main only wakes up
+ * properly once a debounced press is waiting.
  */
 
 #include <P18F4520.h>
+#include <GenericTypeDefs.h>
 
-void delay(int len) {
-    int i;
-    for (i = 0; i < len; i++) {
-        Nop();
-    }
-}
+#define POWER_WAKE_TICKS (256) // 7.8ms at 32.768kHz
+#include "Power-Lib.h"
+
+#define DEBOUNCE_MS (20)
+#define DEBOUNCE_TICK_US (POWER_WAKE_TICKS * 1000000UL / POWER_TICK_HZ)
+#include "Debounce-Lib.h"
+
+#define BUTTONS (1 << 4) // RA4, active low
+#define buttons() (~PORTA & BUTTONS)
+
+PowerStats power;
+void ISR(void);
 
 void main(void) {
-    int poll =0;
+    UINT8 pressed;
     TRISB = 0;
     TRISA |= 1<<4;
 
+    Debounce_setup(buttons());
+    Power_setup();
+    INTCONbits.GIEH = 1;
+
     while(1){
-        /*
-        // if button pressed
-        // wait short while
-        // check button again
-        // wait until button released
-        // toggle
-        */
-       if (PORTAbits.RA4 == 0){
-            delay(7000);
-            if (PORTAbits.RA4 == 0){
-                while (PORTAbits.RA4 == 0);
-                LATB ^= 0x0F;
-            }
-       }
+        // Nothing to do until a press, sleep through the samples
+        INTCONbits.GIEH = 0;
+        if (!debounce_pressed) {
+            Power_idle(POWER_SLEEP);
+        }
+        INTCONbits.GIEH = 1;
+
+        // Toggle once per press, holding the button does nothing more
+        pressed = Debounce_pressed();
+        if (pressed & BUTTONS) {
+            LATB ^= 0x0F;
+            Power_read(&power);
+        }
     }    
-}
\ No newline at end of file
+}
+
+
+#pragma code InterruptVectorHigh = 0x08
+void InterruptVectorHigh(void) {
+    _asm
+    goto ISR
+    _endasm
+}
+#pragma code
+#pragma interrupt ISR save=section(".tmpdata")
+void ISR(void) {
+    if (PIR1bits.TMR1IF) {
+        Power_isr();
+        Debounce_tick(buttons());
+    }
+}
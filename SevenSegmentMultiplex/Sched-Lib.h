@@ -0,0 +1,176 @@
+#ifndef SCHED_LIB_H
+#define SCHED_LIB_H
+
+#include <GenericTypeDefs.h>
+
+/* Tick-based cooperative scheduler with soft timers
+ *
+ * Tasks are plain functions that run to completion in main, never in the
+ * ISR. Each task has an id from 0 to SCHED_MAX_TASKS - 1, which is also its
+ * priority (0 runs first). Posts can come from main or from an ISR, and
+ * posting a task that is still pending does not run it twice.
+ *
+ * Soft timers post a task after a number of ticks, once (period 0) or every
+ * `period` ticks. Sched_tick() is called from the ISR of one hardware timer,
+ * Sched_setupTimer2() sets up Timer2 for a SCHED_TICK_US tick.
+ *
+ * Sched_run() never returns: it runs the highest priority pending task,
+ * then looks again from the top, so a high priority task waits at most for
+ * the one task already running. With nothing pending it calls SCHED_IDLE()
+ * with GIEH = 0, after looking at sched_pending again, and sets GIEH once it
+ * returns. SCHED_IDLE() can then be Sleep() (or Power_idle(POWER_IDLE) from
+ * Power-Lib.h) without losing a tick: the Timer2 flag still wakes the CPU
+ * with GIEH = 0, and the ISR runs when GIEH is set again. Sleep needs
+ * IDLEN = 1 here, Timer2 stops with the oscillator otherwise. The default is
+ * empty, so Sched_run() spins, with a short GIEH = 0 window on every pass.
+ *
+ * Timer2 tick:
+ *   Tcy per tick = FOSC / 4 * SCHED_TICK_US / 1000000
+ *   = prescale (1, 4, 16) * (PR2 + 1) * postscale (1 to 16)
+ *   All three are worked out at compile time. The tick is exact when Tcy
+ *   per tick divides that way (e.g. 1ms at 10MHz = 1 * 250 * 10).
+ *
+ * FOSC (in Hz, as an integer) must be defined before including this file.
+ */
+
+#ifndef FOSC
+#error "FOSC must be defined before including Sched-Lib.h"
+#endif
+#ifndef SCHED_TICK_US
+#define SCHED_TICK_US (1000)
+#endif
+#ifndef SCHED_MAX_TASKS
+#define SCHED_MAX_TASKS (8) // 8 at most, one bit each
+#endif
+#ifndef SCHED_MAX_TIMERS
+#define SCHED_MAX_TIMERS (4)
+#endif
+#ifndef SCHED_IDLE
+#define SCHED_IDLE()
+#endif
+
+#define SCHED_TICK_TCY (FOSC / 4 / 1000 * SCHED_TICK_US / 1000)
+#if SCHED_TICK_TCY > 65536
+#error "SCHED_TICK_US too long for Timer2 (64K Tcy at most)"
+#endif
+#define SCHED_T2_PRE (SCHED_TICK_TCY <= 4096 ? 1 : SCHED_TICK_TCY <= 16384 ? 4 : 16)
+#define SCHED_T2_CKPS (SCHED_TICK_TCY <= 4096 ? 0b00 : SCHED_TICK_TCY <= 16384 ? 0b01 : 0b10)
+#define SCHED_T2_POST ((SCHED_TICK_TCY / SCHED_T2_PRE + 255) / 256)
+#define SCHED_T2_PR2 (SCHED_TICK_TCY / SCHED_T2_PRE / SCHED_T2_POST - 1)
+
+typedef void (*SchedFunc)(void);
+
+typedef struct {
+    UINT16 remaining; // Ticks to go, 0 = stopped
+    UINT16 period; // Reload, 0 = one-shot
+    UINT8 task;
+} SchedTimer;
+
+SchedFunc sched_task[SCHED_MAX_TASKS];
+volatile UINT8 sched_pending = 0; // One bit per task
+SchedTimer sched_timer[SCHED_MAX_TIMERS];
+volatile UINT16 sched_ticks = 0; // Free-running tick count
+
+// Function prototype
+void Sched_init(void);
+void Sched_setupTimer2(void);
+void Sched_addTask(UINT8 id, SchedFunc f);
+void Sched_post(UINT8 id);
+void Sched_startTimer(UINT8 timer, UINT8 task, UINT16 ticks, UINT16 period);
+void Sched_stopTimer(UINT8 timer);
+void Sched_tick(void);
+void Sched_run(void);
+
+
+void Sched_init(void) {
+    UINT8 i;
+    for (i = 0; i < SCHED_MAX_TASKS; i++) {
+        sched_task[i] = 0;
+    }
+    for (i = 0; i < SCHED_MAX_TIMERS; i++) {
+        sched_timer[i].remaining = 0;
+    }
+    sched_pending = 0;
+}
+
+void Sched_setupTimer2(void) {
+    T2CONbits.TMR2ON = 0;
+    T2CONbits.T2CKPS = SCHED_T2_CKPS;
+    T2CONbits.T2OUTPS = SCHED_T2_POST - 1; // 0000 = 1:1 ... 1111 = 1:16
+    PR2 = SCHED_T2_PR2;
+    TMR2 = 0;
+    PIR1bits.TMR2IF = 0;
+    PIE1bits.TMR2IE = 1; // Enable Timer2 interrupt
+    INTCONbits.PEIE = 1; // Enable peripheral interrupts
+    T2CONbits.TMR2ON = 1; // 1 = Timer2 is on
+}
+
+void Sched_addTask(UINT8 id, SchedFunc f) {
+    sched_task[id] = f;
+}
+
+void Sched_post(UINT8 id) {
+    /* Safe from main and from the ISR (GIEH is already 0 there) */
+    UINT8 gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    sched_pending |= 1 << id;
+    INTCONbits.GIEH = gie;
+}
+
+void Sched_startTimer(UINT8 timer, UINT8 task, UINT16 ticks, UINT16 period) {
+    /* Post `task` after `ticks`, then every `period` ticks (0 = once) */
+    UINT8 gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    sched_timer[timer].task = task;
+    sched_timer[timer].period = period;
+    sched_timer[timer].remaining = ticks ? ticks : 1;
+    INTCONbits.GIEH = gie;
+}
+
+void Sched_stopTimer(UINT8 timer) {
+    UINT8 gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+    sched_timer[timer].remaining = 0;
+    INTCONbits.GIEH = gie;
+}
+
+void Sched_tick(void) {
+    /* Call from the ISR once per tick */
+    UINT8 i;
+    sched_ticks++;
+    for (i = 0; i < SCHED_MAX_TIMERS; i++) {
+        SchedTimer *t = &sched_timer[i];
+        if (t->remaining != 0 && --t->remaining == 0) {
+            sched_pending |= 1 << t->task;
+            t->remaining = t->period;
+        }
+    }
+}
+
+void Sched_run(void) {
+    UINT8 id, mask, pending;
+    while (1) {
+        pending = sched_pending;
+        if (pending == 0) {
+            INTCONbits.GIEH = 0;
+            if (sched_pending == 0) {
+                SCHED_IDLE(); // Called with GIEH = 0, see above
+            }
+            INTCONbits.GIEH = 1; // A tick that woke SCHED_IDLE() is taken here
+            continue;
+        }
+
+        // Highest priority first
+        for (id = 0, mask = 1; !(pending & mask); id++, mask <<= 1);
+
+        INTCONbits.GIEH = 0;
+        sched_pending &= ~mask;
+        INTCONbits.GIEH = 1;
+
+        if (sched_task[id]) {
+            sched_task[id]();
+        }
+    }
+}
+
+#endif
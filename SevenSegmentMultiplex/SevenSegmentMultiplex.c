@@ -8,8 +8,14 @@
  * Segments A-G are on RD[0:6] and are active LOW.
  * Common selector pins are on RE[0:1] and are active HIGH.
  *
- * Timer 0 is used to multiplex the display by switching to
- * the next digit every interrupt.
+ * Timer 2 gives a 1ms scheduler tick (Sched-Lib.h). A periodic
+ * soft timer switches to the next digit every tick, and another
+ * one counts up every 100ms, both as tasks in main.
+ *
+ * The tick ISR is timed with Prof-Lib.h (Timer3): latency from
+ * the PR2 match, duration and CPU load go to `prof_stats` and
+ * `prof_load` for the watch window, and RB0 is high while the
+ * ISR runs, for a scope.
  * 
  */
 
@@ -17,6 +23,25 @@
 #include <GenericTypeDefs.h>
 #include <delays.h>
 
+#define FOSC (10000000UL) // 10MHz HS mode
+#define SCHED_TICK_US (1000)
+#include "Sched-Lib.h"
+#define PROF_ENABLE // Comment out to take the instrumentation out
+#define PROF_PINS LATB // RB0 high in the tick ISR
+#define PROF_SOURCES (1)
+#include "Prof-Lib.h"
+
+// Profiled interrupt sources
+#define PROF_TICK (0)
+
+// Tasks, in priority order
+#define TASK_MUX   (0)
+#define TASK_COUNT (1)
+
+// Soft timers
+#define TIMER_MUX   (0)
+#define TIMER_COUNT (1)
+
 const UINT8 SEVEN_SEGMENT[] = {
     0x3F, // 0
     0x06, // 1
@@ -32,10 +57,15 @@ const UINT8 SEVEN_SEGMENT[] = {
 
 UINT8 mux_digits[4] = {0, 0, 0, 0};
 UINT8 mux_selector = 0;
+UINT16 count = 0;
+ProfStats prof_stats;
+UINT16 prof_load; // Permille
 
 void main(void);
 void mux_UpdateDisplay(UINT8);
 void mux_SetDigits(UINT16);
+void mux_task(void);
+void count_task(void);
 void InterruptHandlerHigh(void);
 
 void main(void) {
@@ -43,28 +73,42 @@ void main(void) {
     TRISD = 0x00;
     TRISEbits.TRISE0 = 0;
     TRISEbits.TRISE1 = 0;
+    TRISBbits.TRISB0 = 0; // Profiling pin
     
-    // Setup Timer 0 for mux
-    T0CONbits.TMR0ON = 1; // 1 = Enables Timer0
-    T0CONbits.T08BIT = 1; // 1 = Timer0 is configured as an 8-bit timer/counter 
-    T0CONbits.T0CS = 0; // 0 = Internal instruction cycle clock (CLKO) 
-    T0CONbits.PSA = 1; // 0 = Timer0 prescaler is not assigned
+    // Setup tasks and soft timers
+    Sched_init();
+    Sched_addTask(TASK_MUX, mux_task);
+    Sched_addTask(TASK_COUNT, count_task);
+    Sched_startTimer(TIMER_MUX, TASK_MUX, 1, 1); // Next digit every 1ms
+    Sched_startTimer(TIMER_COUNT, TASK_COUNT, 100, 100); // Count every 100ms
     
-    // Enable Timer 0 interrupt
+    // Setup Timer 2 for the 1ms tick, Timer 3 to time it
+    Prof_setup();
+    Sched_setupTimer2();
     INTCONbits.GIEH = 1;
     INTCONbits.GIEL = 1;
-    INTCONbits.TMR0IE = 1; // 1 = Enables the TMR0 overflow interrupt 
-    INTCONbits.TMR0IF = 0; // Clear Timer 0 Interrupt Flag
     
-    while (1) {
-        UINT16 i;
-        for (i = 0; i < 10000; i++) {
-            mux_SetDigits(i);
-            Delay10KTCYx(25);
-        }
+    Sched_run(); // Never returns
+}
+
+void mux_task(void) {
+    // Multiplex display every tick
+    mux_UpdateDisplay(mux_selector++);
+    if (mux_selector >= 4) {
+        mux_selector = 0;
     }
 }
 
+void count_task(void) {
+    if (++count >= 10000) {
+        count = 0;
+    }
+    mux_SetDigits(count);
+    
+    Prof_read(PROF_TICK, &prof_stats);
+    prof_load = Prof_load();
+}
+
 void mux_SetDigits(UINT16 input) {
     mux_digits[0] = input % 10;
     input /= 10;
@@ -92,18 +136,13 @@ void InterruptVectorHigh (void) {
 }
 
 #pragma code
-#pragma interrupt InterruptHandlerHigh
+#pragma interrupt InterruptHandlerHigh save=PROD,section(".tmpdata"),section("MATH_DATA")
 void InterruptHandlerHigh(void) {
-    if (INTCONbits.TMR0IF) {
-        // Multiplex display every timer interrupt
-        mux_UpdateDisplay(mux_selector++);
-        if (mux_selector >= 4) {
-            mux_selector = 0;
-        }
-        TMR0L = 8; // Reset timer value
-        // 10MHz Crystal at HS mode
-        // Fosc/4 = 2.5Mhz
-        // 3us / (1/2.5MHz) = 7.5
-        INTCONbits.TMR0IF = 0; // Clear Timer 0 Interrupt Flag
+    if (PIR1bits.TMR2IF) {
+        PROF_ENTER(PROF_TICK)
+        PROF_LATENCY(PROF_TICK, TMR2 * SCHED_T2_PRE) // TMR2 restarts from 0 at the match
+        PIR1bits.TMR2IF = 0; // Clear Timer 2 Interrupt Flag
+        Sched_tick(); // Soft timers post their tasks
+        PROF_EXIT(PROF_TICK)
     }
 }
\ No newline at end of file
@@ -0,0 +1,152 @@
+#ifndef CLOCK_LIB_H
+#define CLOCK_LIB_H
+
+#include <GenericTypeDefs.h>
+#include <delays.h>
+
+/* System clock switching with peripheral retiming
+ *
+ * Clock_set() switches between the three clock sources of the PIC18F4520:
+ *   CLOCK_PRIMARY    SCS = 00, as set by the config bits (crystal, or the
+ *                    internal block with PLL), runs at FOSC
+ *   CLOCK_SECONDARY  SCS = 01, 32.768kHz Timer1 oscillator (RC0/RC1)
+ *   CLOCK_INTOSC     SCS = 1x, internal block at the IRCF frequency, 31kHz
+ *                    to 8MHz, no PLL
+ * It waits until the new source is running (OSTS, T1RUN or IOFS), then
+ * calls every function registered with Clock_register() with the new clock
+ * in Hz, so timers, baud rates, PWM periods and ADC timing can be worked out
+ * again. Anything left on compile-time timing is only right at FOSC.
+ *
+ * Slowing down while there is nothing to do saves power, as the current is
+ * roughly proportional to the clock.
+ *
+ * The switch and the callbacks run with interrupts off, so no ISR sees a
+ * peripheral half set up for the other clock.
+ *
+ * With the internal block as the primary oscillator, IRCF sets the primary
+ * frequency too: define CLOCK_PRIMARY_IRCF to have it put back when going
+ * back to CLOCK_PRIMARY. Stability is then read from IOFS instead of OSTS,
+ * and with the PLL on, another 2ms is waited for it to lock.
+ *
+ * FOSC (the primary clock in Hz, as an integer) must be defined before
+ * including this file.
+ */
+
+#ifndef FOSC
+#error "FOSC must be defined before including Clock-Lib.h"
+#endif
+#ifndef CLOCK_MAX_CALLBACKS
+#define CLOCK_MAX_CALLBACKS (4)
+#endif
+#ifndef CLOCK_TIMEOUT
+#define CLOCK_TIMEOUT (50000) // Polls before giving up on a source
+#endif
+
+#define CLOCK_PRIMARY   (0)
+#define CLOCK_SECONDARY (1)
+#define CLOCK_INTOSC    (2)
+
+#define CLOCK_T1OSC_HZ (32768UL)
+
+/* IRCF<2:0> -> internal block frequency */
+const UINT32 CLOCK_IRCF_HZ[8] = {
+    31250, 125000, 250000, 500000, 1000000, 2000000, 4000000, 8000000
+};
+
+typedef void (*ClockFunc)(UINT32 fosc);
+
+ClockFunc clock_callback[CLOCK_MAX_CALLBACKS];
+UINT8 clock_callbacks = 0;
+UINT8 clock_mode = CLOCK_PRIMARY;
+UINT32 clock_fosc = FOSC;
+
+// Function prototype
+BOOL Clock_register(ClockFunc f);
+BOOL Clock_set(UINT8 mode, UINT8 ircf);
+UINT32 Clock_getFosc(void);
+
+
+BOOL Clock_register(ClockFunc f) {
+    /* f(fosc) is called after every clock change */
+    if (clock_callbacks >= CLOCK_MAX_CALLBACKS) {
+        return FALSE;
+    }
+    clock_callback[clock_callbacks++] = f;
+    return TRUE;
+}
+
+BOOL Clock_set(UINT8 mode, UINT8 ircf) {
+    /* mode: CLOCK_PRIMARY, CLOCK_SECONDARY or CLOCK_INTOSC
+     * ircf: internal block frequency for CLOCK_INTOSC (0b000 - 0b111)
+     * FALSE if the source did not start, the clock is left unchanged then
+     */
+    UINT8 gie, i;
+    UINT16 timeout = CLOCK_TIMEOUT;
+    UINT8 old_scs = OSCCONbits.SCS;
+    UINT8 old_ircf = OSCCONbits.IRCF;
+    BOOL ok = FALSE;
+
+    gie = INTCONbits.GIEH;
+    INTCONbits.GIEH = 0;
+
+    switch (mode) {
+        case CLOCK_PRIMARY:
+#ifdef CLOCK_PRIMARY_IRCF
+            OSCCONbits.IRCF = CLOCK_PRIMARY_IRCF;
+            OSCCONbits.SCS = 0b00; // 00 = Primary oscillator
+            while (timeout-- && !(ok = OSCCONbits.IOFS)); // 1 = INTOSC frequency is stable
+            if (ok && OSCTUNEbits.PLLEN) {
+                Delay100TCYx(FOSC / 4 / 500 / 100); // 2ms PLL lock
+            }
+#else
+            OSCCONbits.SCS = 0b00; // 00 = Primary oscillator
+            while (timeout-- && !(ok = OSCCONbits.OSTS)); // 1 = Start-up timer expired, running
+#endif
+            clock_fosc = FOSC;
+            break;
+
+        case CLOCK_SECONDARY:
+            T1CONbits.T1OSCEN = 1; // 1 = Timer1 oscillator is enabled
+            OSCCONbits.SCS = 0b01; // 01 = Timer1 oscillator
+            while (timeout-- && !(ok = T1CONbits.T1RUN)); // 1 = Clock derived from Timer1 osc.
+            clock_fosc = CLOCK_T1OSC_HZ;
+            break;
+
+        case CLOCK_INTOSC:
+            OSCCONbits.IRCF = ircf;
+            OSCCONbits.SCS = 0b10; // 1x = Internal oscillator block
+            while (timeout-- && !(ok = OSCCONbits.IOFS)); // 1 = INTOSC frequency is stable
+            clock_fosc = CLOCK_IRCF_HZ[ircf & 0b111];
+            break;
+    }
+
+    if (!ok) {
+        // Back to where we were, nothing to retime
+        OSCCONbits.IRCF = old_ircf;
+        OSCCONbits.SCS = old_scs;
+        clock_fosc = Clock_getFosc();
+        INTCONbits.GIEH = gie;
+        return FALSE;
+    }
+
+    clock_mode = mode;
+    for (i = 0; i < clock_callbacks; i++) {
+        clock_callback[i](clock_fosc);
+    }
+    INTCONbits.GIEH = gie;
+    return TRUE;
+}
+
+UINT32 Clock_getFosc(void) {
+    /* Current clock in Hz, from OSCCON */
+    UINT8 scs = OSCCONbits.SCS;
+    if (scs & 0b10) {
+        return CLOCK_IRCF_HZ[OSCCONbits.IRCF];
+    }
+    if (scs == 0b01) {
+        return CLOCK_T1OSC_HZ;
+    }
+    return FOSC;
+}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef OSC_TRIM_H
+#define OSC_TRIM_H
+
+#include <GenericTypeDefs.h>
+
+/* OSCTUNE trim of the internal oscillator against the 32.768kHz crystal
+ *
+ * The internal oscillator is only factory calibrated to about 1% and moves
+ * with temperature and supply. Timer1 runs from its own oscillator (the
+ * 32.768kHz crystal on RC0/RC1), and Timer0 counts instruction cycles over
+ * OSC_TRIM_WINDOW Timer1 ticks:
+ *   expected = FOSC / 4 / 2 * OSC_TRIM_WINDOW / 32768
+ *   16MHz (4MHz x4 PLL), 1:2, 512 ticks (15.6ms) -> 31250
+ * OSCTUNE TUN<4:0> (two's complement, -16 to 15, higher is faster) is then
+ * stepped from its current value towards the expected count, and the value
+ * with the smallest error is kept.
+ *
+ * Timer0 is left as a 16-bit, 1:2 internal timer and Timer1 keeps running
+ * from the crystal. The crystal can take a second or two to start, so
+ * OSC_trim() waits up to OSC_TRIM_TRIES windows for it.
+ *
+ * FOSC (in Hz, as an integer) must be defined before including this file.
+ */
+
+#ifndef FOSC
+#error "FOSC must be defined before including OSC-Trim.h"
+#endif
+#ifndef OSC_TRIM_WINDOW
+#define OSC_TRIM_WINDOW (512) // Timer1 ticks per measurement
+#endif
+#ifndef OSC_TRIM_TRIES
+#define OSC_TRIM_TRIES (100) // Crystal start-up, ~3s at 16MHz
+#endif
+#define OSC_TRIM_TARGET ((UINT16) (FOSC / 4 / 2 * OSC_TRIM_WINDOW / 32768))
+
+// Function prototype
+UINT16 OSC_readTimer1(void);
+UINT16 OSC_measure(void);
+INT8 OSC_getTune(void);
+BOOL OSC_trim(void);
+
+
+UINT16 OSC_readTimer1(void) {
+    UINT16 t = TMR1L; // Latches TMR1H
+    return t | ((UINT16) TMR1H << 8);
+}
+
+UINT16 OSC_measure(void) {
+    /* Timer0 counts over OSC_TRIM_WINDOW Timer1 ticks, 0 when Timer1
+     * stands still (Timer0 overflows first)
+     */
+    UINT16 start, t0;
+
+    TMR0H = 0;
+    TMR0L = 0;
+    INTCONbits.TMR0IF = 0;
+    start = OSC_readTimer1();
+    while (OSC_readTimer1() == start) { // Line up with a Timer1 tick
+        if (INTCONbits.TMR0IF) {
+            return 0;
+        }
+    }
+    TMR0H = 0;
+    TMR0L = 0;
+    start++;
+    while ((UINT16) (OSC_readTimer1() - start) < OSC_TRIM_WINDOW) {
+        if (INTCONbits.TMR0IF) {
+            return 0;
+        }
+    }
+    t0 = TMR0L;
+    return t0 | ((UINT16) TMR0H << 8);
+}
+
+INT8 OSC_getTune(void) {
+    INT8 tun = OSCTUNEbits.TUN;
+    if (tun & 0x10) {
+        tun -= 32; // Sign extend 5 bits
+    }
+    return tun;
+}
+
+BOOL OSC_trim(void) {
+    /* TRUE when the crystal is running and OSCTUNE was set */
+    UINT16 count, err, best_err;
+    INT8 tun, best_tun, step;
+    UINT8 i;
+
+    /* Timer0: 16-bit, FOSC/4, 1:2 */
+    T0CONbits.T08BIT = 0; // 0 = 16-bit timer/counter
+    T0CONbits.T0CS = 0; // 0 = Internal instruction cycle clock
+    T0CONbits.PSA = 0; // 0 = Timer0 prescaler is assigned
+    T0CONbits.T0PS = 0b000; // 1:2 prescale value
+    T0CONbits.TMR0ON = 1;
+
+    /* Timer1: 32.768kHz crystal on RC0/RC1 */
+    T1CONbits.RD16 = 1; // 16-bit read
+    T1CONbits.T1CKPS = 0b00; // 1:1
+    T1CONbits.T1OSCEN = 1; // 1 = Timer1 oscillator is enabled
+    T1CONbits.NOT_T1SYNC = 0; // 0 = Synchronize with the internal clock
+    T1CONbits.TMR1CS = 1; // 1 = External clock from the Timer1 oscillator
+    T1CONbits.TMR1ON = 1;
+
+    count = 0;
+    for (i = 0; i < OSC_TRIM_TRIES && count == 0; i++) {
+        count = OSC_measure();
+    }
+    if (count == 0) {
+        return FALSE; // No crystal
+    }
+    count = OSC_measure(); // Crystal has been running a whole window
+
+    tun = OSC_getTune();
+    best_tun = tun;
+    best_err = (count > OSC_TRIM_TARGET) ? count - OSC_TRIM_TARGET : OSC_TRIM_TARGET - count;
+    step = (count < OSC_TRIM_TARGET) ? 1 : -1; // Too slow -> tune up
+
+    while (best_err != 0) {
+        tun += step;
+        if (tun < -16 || tun > 15) {
+            break;
+        }
+        OSCTUNEbits.TUN = tun;
+        OSC_measure(); // Let the oscillator settle
+        count = OSC_measure();
+        err = (count > OSC_TRIM_TARGET) ? count - OSC_TRIM_TARGET : OSC_TRIM_TARGET - count;
+        if (count == 0 || err >= best_err) {
+            break; // Past the best setting
+        }
+        best_err = err;
+        best_tun = tun;
+    }
+    OSCTUNEbits.TUN = best_tun;
+    return TRUE;
+}
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef RING_LIB_H
+#define RING_LIB_H
+
+#include <GenericTypeDefs.h>
+
+/* ISR to main handoff without losing events
+ *
+ * A BOOL flag set in the ISR loses events: two before main looks read as
+ * one. These keep them all, with one producer (the ISR) and one consumer
+ * (main), and neither side masks interrupts:
+ *
+ *   EventCount    the ISR counts with Count_post(), main takes everything
+ *                 counted since it last looked with Count_take(). Up to 255
+ *                 events can be waiting
+ *   Ring          a queue of bytes (Ring16: words), for events that carry a
+ *                 value. Ring_put() from the ISR, Ring_get() from main
+ *
+ * Each side only writes its own index (produced/head in the ISR, consumed/
+ * tail in main) and the other side only reads it. A byte is read or
+ * written in one instruction, so it is never seen half written. A ring
+ * entry is written before head is moved and read before tail is moved, so
+ * a word is never seen half written either.
+ *
+ * Ring_put() and Count_post() have no loops: a fixed, short time in the
+ * ISR. A full ring drops the new value and counts it in `dropped`.
+ *
+ * Ring sizes are a power of 2, from 2 to 128, set by the buffer passed to
+ * Ring_init(). One entry is kept empty to tell full from empty.
+ */
+
+typedef struct {
+    volatile UINT8 produced; // ISR only
+    UINT8 consumed; // main only
+} EventCount;
+
+typedef struct {
+    UINT8 *buf;
+    UINT8 mask; // Size - 1
+    volatile UINT8 head; // Next to write, ISR only
+    volatile UINT8 tail; // Next to read, main only
+    UINT8 dropped;
+} Ring;
+
+typedef struct {
+    UINT16 *buf;
+    UINT8 mask;
+    volatile UINT8 head;
+    volatile UINT8 tail;
+    UINT8 dropped;
+} Ring16;
+
+// Function prototype
+void Count_init(EventCount *c);
+void Count_post(EventCount *c);
+UINT8 Count_take(EventCount *c);
+BOOL Count_pending(EventCount *c);
+void Ring_init(Ring *r, UINT8 *buf, UINT8 size);
+BOOL Ring_put(Ring *r, UINT8 v);
+BOOL Ring_get(Ring *r, UINT8 *v);
+UINT8 Ring_count(Ring *r);
+void Ring16_init(Ring16 *r, UINT16 *buf, UINT8 size);
+BOOL Ring16_put(Ring16 *r, UINT16 v);
+BOOL Ring16_get(Ring16 *r, UINT16 *v);
+UINT8 Ring16_count(Ring16 *r);
+
+
+//----------------------------------------------------------------------------
+// Event counters
+
+void Count_init(EventCount *c) {
+    c->produced = 0;
+    c->consumed = 0;
+}
+
+void Count_post(EventCount *c) {
+    /* From the ISR */
+    c->produced++;
+}
+
+UINT8 Count_take(EventCount *c) {
+    /* From main: events since the last call */
+    UINT8 now = c->produced;
+    UINT8 n = now - c->consumed; // Modulo 256
+    c->consumed = now;
+    return n;
+}
+
+BOOL Count_pending(EventCount *c) {
+    return c->produced != c->consumed;
+}
+
+//----------------------------------------------------------------------------
+// Ring buffers
+
+void Ring_init(Ring *r, UINT8 *buf, UINT8 size) {
+    r->buf = buf;
+    r->mask = size - 1;
+    r->head = 0;
+    r->tail = 0;
+    r->dropped = 0;
+}
+
+BOOL Ring_put(Ring *r, UINT8 v) {
+    /* From the ISR. FALSE if full, v is dropped */
+    UINT8 head = r->head;
+    UINT8 next = (head + 1) & r->mask;
+    if (next == r->tail) {
+        r->dropped++;
+        return FALSE;
+    }
+    r->buf[head] = v;
+    r->head = next; // Publish after the value is written
+    return TRUE;
+}
+
+BOOL Ring_get(Ring *r, UINT8 *v) {
+    /* From main. FALSE if empty */
+    UINT8 tail = r->tail;
+    if (tail == r->head) {
+        return FALSE;
+    }
+    *v = r->buf[tail];
+    r->tail = (tail + 1) & r->mask; // Free the slot after it is read
+    return TRUE;
+}
+
+UINT8 Ring_count(Ring *r) {
+    return (r->head - r->tail) & r->mask;
+}
+
+void Ring16_init(Ring16 *r, UINT16 *buf, UINT8 size) {
+    r->buf = buf;
+    r->mask = size - 1;
+    r->head = 0;
+    r->tail = 0;
+    r->dropped = 0;
+}
+
+BOOL Ring16_put(Ring16 *r, UINT16 v) {
+    /* From the ISR. FALSE if full, v is dropped */
+    UINT8 head = r->head;
+    UINT8 next = (head + 1) & r->mask;
+    if (next == r->tail) {
+        r->dropped++;
+        return FALSE;
+    }
+    r->buf[head] = v;
+    r->head = next; // Publish after both bytes are written
+    return TRUE;
+}
+
+BOOL Ring16_get(Ring16 *r, UINT16 *v) {
+    /* From main. FALSE if empty */
+    UINT8 tail = r->tail;
+    if (tail == r->head) {
+        return FALSE;
+    }
+    *v = r->buf[tail];
+    r->tail = (tail + 1) & r->mask; // Free the slot after it is read
+    return TRUE;
+}
+
+UINT8 Ring16_count(Ring16 *r) {
+    return (r->head - r->tail) & r->mask;
+}
+
+#endif
@@ -2,32 +2,59 @@
  * PICDEM 2 PLUS DEMO BOARD
  * PIC18F4520
  * 
- * Timer 0 is set to trigger an interrupt every 100ms when
- * the clock is set to 10MHz (Fosc = 10 MHz) and toggle an
- * LED on RB0.
+ * Timer 0 is set to trigger an interrupt every 100ms and
+ * toggle an LED on RB0.
  * 
  * Clock sources can be played around by modifying OSCCON
  * and OSCTUNE register or OSC configuration bits.
- * The push button on RA4 will toggle the clock source
- * between primary oscillator, secondary oscillator and 
- * internal oscillator.
+ * Each press of the push button on RA4 steps the clock source
+ * (Clock-Lib.h) through:
+ *     primary   16MHz (4MHz internal oscillator x4 PLL)
+ *     internal  1MHz
+ *     secondary 32.768kHz (Timer1 crystal)
+ * Timer 0 is retimed after every change, so RB0 keeps
+ * blinking at 100ms while the CPU (RB3) slows down.
+ *
+ * At start-up the internal oscillator is trimmed with OSCTUNE
+ * against the 32.768kHz Timer1 crystal (OSC-Trim.h).
+ *
+ * Timer 0 periods are counted in the ISR (Ring-Lib.h), so
+ * none are lost when main is slow to look at them. That only
+ * holds while the ISR can run: TMR0IF is one flag, so if
+ * GIEH is off for longer than one overflow, the overflows in
+ * that time merge into one. Clock_set() holds GIEH off while
+ * the new source starts, and then Timer0_retime() starts a
+ * new period, so the blink slips by the time of the switch.
  */
 
 #include <P18F4520.h>
 #include <GenericTypeDefs.h>
 #include <delays.h>
 
-BOOL timer0_flag = FALSE;
+#define FOSC (16000000UL) // 4MHz internal oscillator x4 PLL
+#define TIMER0_PERIOD_US (100000UL) // 100ms
+#define CLOCK_PRIMARY_IRCF (0b110) // Primary is the 4MHz internal block
+#include "OSC-Trim.h"
+#include "Timer0-Lib.h"
+#include "Clock-Lib.h"
+#include "Ring-Lib.h"
+
+EventCount timer0_ticks;
 void ISR(void);
 
 void main(void) {
-    UINT8 clock = 0;
+    UINT8 clock = CLOCK_PRIMARY;
+    UINT8 lockout = 0; // Timer 0 periods before RA4 is looked at again
+    UINT8 ticks;
     
     // Internal Oscillator with PLL (2.6.4 PLL IN INTOSC MODES))
     // OSCCONbits.IRCF = 0b111; // Internal Oscillator Frequency (FOSC = 8MHz)
     OSCCONbits.IRCF = 0b110; // Internal Oscillator Frequency (FOSC = 4MHz)
     OSCTUNEbits.PLLEN = 1; // Enable PLL for internal osc. (after setting FOSC > 4MHz)
     
+    // Trim INTOSC against the Timer1 crystal (keeps factory value without it)
+    OSC_trim();
+    
     // RA4 as input
     TRISA |= 1<<4;
     
@@ -36,25 +63,35 @@ void main(void) {
     LATB = 0;
 
     // Enable global and peripheral interrupts
+    Count_init(&timer0_ticks);
     INTCONbits.GIEH = 1;
     INTCONbits.PEIE = 1;
     
-    // Setup Timer 0
-    T0CONbits.TMR0ON = 1; // Enables Timer0 
-    T0CONbits.T08BIT = 0; // 0 = 16-bit timer/counter 
-    T0CONbits.T0CS = 0; // internal clock source
-    T0CONbits.PSA = 0; // 0 = Timer0 prescaler is assigned. 
-    T0CONbits.T0PS = 0b000; // 1:2 prescale value
-    INTCONbits.TMR0IE = 1; // Enable timer 0
+    // Setup Timer 0, 100ms period worked out from FOSC
+    Timer0_setupPeriodic();
+    Clock_register(Timer0_retime); // Same period at every clock
     
     while (1) {
-        if (PORTAbits.RA4 == 0) {
-            // Change clock source (Primary / Internal)
-            OSCCONbits.SCS = clock++ & 0b11; 
+        if (PORTAbits.RA4 == 0 && lockout == 0) {
+            // Next clock source, once per press
+            if (clock == CLOCK_PRIMARY) {
+                clock = CLOCK_INTOSC;
+            } else if (clock == CLOCK_INTOSC) {
+                clock = CLOCK_SECONDARY;
+            } else {
+                clock = CLOCK_PRIMARY;
+            }
+            if (!Clock_set(clock, 0b100)) { // 100 = 1MHz internal
+                clock = clock_mode; // Source did not start
+            }
+            lockout = 3;
         }
-        if (timer0_flag) {
-            timer0_flag = FALSE;
+        ticks = Count_take(&timer0_ticks);
+        while (ticks--) {
             LATB ^= 1<<0; // Blink RB0 LED
+            if (lockout > 0 && (PORTAbits.RA4 || lockout > 1)) {
+                lockout--; // Released, or still bouncing
+            }
         }
         LATB ^= 1<<3; // Blink RB0 LED
     }
@@ -75,20 +112,17 @@ void InterruptVectorHigh (void) {
 // High priority interrupt routine
 
 #pragma code
-#pragma interrupt ISR
+#pragma interrupt ISR save=section(".tmpdata")
 
 void ISR() {
     if (INTCONbits.TMR0IF) {
-        /* Calculation for reset value of timer
-         *   Overflow at 0xFFFF = 65535
-         *   Number to count = 100/104.87 * 65535 = 62491
-         *   0 to 65535 -> 104.87ms
-         *   0 to 62491 -> 100ms
-         *   3044 to 65535 -> 100ms
+        /* Reload and wrap count come from Timer0-Lib.h:
+         *   16MHz -> 400000 Tcy = 6784 + 6 * 65536
+         * The reload is added to the running count, so the
+         * interrupt latency does not add up over the periods
          */
-        TMR0H = 3044 >> 8; // Reset timer
-        TMR0L = 3044 & 0xFF; // Reset timer
-        INTCONbits.TMR0IF = 0; //clear interrupt flag
-        timer0_flag = TRUE;
+        if (Timer0_isr()) {
+            Count_post(&timer0_ticks);
+        }
     }
 }
\ No newline at end of file